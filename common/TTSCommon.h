@@ -24,10 +24,14 @@ namespace TTS {
 enum ResourceAllocationPolicy {
     INVALID_POLICY = -1,
     RESERVATION, // Resource must be reserved before usage
-    PRIORITY,    // NOT IMPLEMENTED
+    PRIORITY,    // Any client can use the resource, higher priority speech preempts the lower
     OPEN         // Any client can use the resource without any prior reservation
 };
 
+// Speech priority (tier) of a session under PRIORITY policy, 0 - lowest
+#define TTS_MAX_PRIORITY 3
+#define TTS_PRIORITY_TIERS (TTS_MAX_PRIORITY + 1)
+
 enum SpeechState {
     SPEECH_PENDING = 0,
     SPEECH_IN_PROGRESS,
@@ -0,0 +1,107 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_EVENT_BATCH_H_
+#define _TTS_EVENT_BATCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+namespace TTS {
+
+// Clients listening to this event get the events of a main loop dispatch in a single
+// message, instead of one message per event
+#define TTS_EVENT_BATCH "events"
+
+#define EVENT_FIELD_STRING 's'
+#define EVENT_FIELD_NUMBER 'u'
+
+struct EventField {
+    std::string key;
+    char type;          // EVENT_FIELD_STRING / EVENT_FIELD_NUMBER
+    std::string value;
+};
+
+// The batch is a string of records, each one being "<name><field count>," followed by the
+// fields as "<key><type><value>", where the name, key & value are "<length>:<bytes>"
+inline void appendLengthPrefixed(std::string &batch, const std::string &str) {
+    batch += std::to_string(str.size());
+    batch += ':';
+    batch += str;
+}
+
+inline void appendEventRecord(std::string &batch, const std::string &name, const std::vector<EventField> &fields) {
+    appendLengthPrefixed(batch, name);
+    batch += std::to_string(fields.size());
+    batch += ',';
+    for(auto &field : fields) {
+        appendLengthPrefixed(batch, field.key);
+        batch += field.type;
+        appendLengthPrefixed(batch, field.value);
+    }
+}
+
+inline bool readLengthPrefixed(const char *&p, const char *end, std::string &str) {
+    char *next = NULL;
+    unsigned long length = strtoul(p, &next, 10);
+    if(next == p || next >= end || *next != ':' || length > (unsigned long)(end - next - 1))
+        return false;
+    str.assign(next + 1, length);
+    p = next + 1 + length;
+    return true;
+}
+
+// Calls f(name, fields) for every record, returns false on a malformed batch
+template<typename F>
+inline bool forEachEventRecord(const char *batch, size_t length, F f) {
+    const char *p = batch;
+    const char *end = batch + length;
+    std::string name;
+    std::vector<EventField> fields;
+    while(p < end) {
+        if(!readLengthPrefixed(p, end, name))
+            return false;
+
+        char *next = NULL;
+        unsigned long count = strtoul(p, &next, 10);
+        if(next == p || next >= end || *next != ',')
+            return false;
+        p = next + 1;
+
+        fields.clear();
+        for(unsigned long i = 0; i < count; ++i) {
+            EventField field;
+            if(!readLengthPrefixed(p, end, field.key) || p >= end)
+                return false;
+            field.type = *p++;
+            if(!readLengthPrefixed(p, end, field.value))
+                return false;
+            fields.push_back(std::move(field));
+        }
+
+        f(name, fields);
+    }
+    return true;
+}
+
+} // namespace TTS
+
+#endif
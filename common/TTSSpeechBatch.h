@@ -0,0 +1,66 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_SPEECH_BATCH_H_
+#define _TTS_SPEECH_BATCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string>
+
+namespace TTS {
+
+// A batch of speeches travels in a single rtRemote call as a string of
+// "<id>,<secure>,<length>:<text>" records (length of the text in bytes),
+// so that the texts can have any character & the batch needs no escaping.
+inline void appendSpeechRecord(std::string &batch, uint32_t id, bool secure, const std::string &text) {
+    batch += std::to_string(id);
+    batch += secure ? ",1," : ",0,";
+    batch += std::to_string(text.size());
+    batch += ':';
+    batch += text;
+}
+
+// Calls f(id, secure, text, length) for every record, returns false on a malformed batch
+template<typename F>
+inline bool forEachSpeechRecord(const char *batch, size_t length, F f) {
+    const char *p = batch;
+    const char *end = batch + length;
+    while(p < end) {
+        char *next = NULL;
+        unsigned long id = strtoul(p, &next, 10);
+        if(next == p || next + 3 > end || next[0] != ',' || (next[1] != '0' && next[1] != '1') || next[2] != ',')
+            return false;
+        bool secure = (next[1] == '1');
+
+        p = next + 3;
+        unsigned long textLength = strtoul(p, &next, 10);
+        if(next == p || next >= end || *next != ':' || textLength > (unsigned long)(end - next - 1))
+            return false;
+
+        p = next + 1;
+        f((uint32_t)id, secure, p, (size_t)textLength);
+        p += textLength;
+    }
+    return true;
+}
+
+} // namespace TTS
+
+#endif
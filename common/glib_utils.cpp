@@ -91,13 +91,16 @@ std::vector<std::string> split(const std::string &str, const char delim) {
     std::string::size_type prevPos = 0, pos = 0;
     std::vector<std::string> tokens;
 
-    while(!str.empty() && (pos = str.find(delim, pos)) != std::string::npos) {
+    if(str.empty())
+        return tokens;
+
+    while((pos = str.find(delim, pos)) != std::string::npos) {
         tokens.push_back(str.substr(prevPos, pos - prevPos));
         prevPos = ++pos;
     }
 
-    if(!str.empty() && prevPos < str.length())
-        tokens.push_back(str.substr(prevPos, pos - prevPos));
+    // The last field is kept even when empty, "a,b," has three fields
+    tokens.push_back(str.substr(prevPos));
 
     return tokens;
 }
@@ -21,61 +21,209 @@
 #include <cstring>
 #include <cstdarg>
 #include <cstdlib>
+#include <cstdint>
 #include <ctime>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #ifdef USE_RDK_LOGGER
 #include "rdk_debug.h"
 #endif
 
 namespace TTS {
 
+#define DEFAULT_LOG_RATE_LIMIT 50   // Messages per second of a call site
+#define RATE_LIMIT_SLOTS 128
+#define LOG_RING_SLOTS 256          // Must be a power of 2
+#define LOG_RECORD_SIZE 1024
+#define LOG_WRITER_IDLE_MS 1000
+#define LOG_TRUNCATION_MARK "... [truncated]"
+
+#ifdef USE_RDK_LOGGER
+// TTSLogger is backed with log4c which has its own default level
+// for filtering messages. Therefore, nothing is filtered here by default.
+std::atomic<int> gLogLevel(TRACE_LEVEL);
+#else
+std::atomic<int> gLogLevel(INFO_LEVEL);
+#endif
+
+static uint32_t gRateLimit = DEFAULT_LOG_RATE_LIMIT;
+
 static inline void sync_stdout()
 {
     if (getenv("SYNC_STDOUT"))
         setvbuf(stdout, NULL, _IOLBF, 0);
 }
 
-const char* methodName(const std::string& prettyFunction)
+const char* methodName(const char* prettyFunction)
 {
-    size_t colons = prettyFunction.find("::");
-    size_t begin = prettyFunction.substr(0,colons).rfind(" ") + 1;
-    size_t end = prettyFunction.rfind("(") - begin;
+    // "<return type> Namespace::Class::method(<args>)" => "Namespace::Class::method"
+    static thread_local char name[256];
+    const char *end = strchr(prettyFunction, '(');
+    if (!end)
+        end = prettyFunction + strlen(prettyFunction);
+
+    const char *colons = strstr(prettyFunction, "::");
+    const char *limit = (colons && colons < end) ? colons : end;
+    const char *begin = prettyFunction;
+    for (const char *c = prettyFunction; c < limit; ++c)
+        if (*c == ' ')
+            begin = c + 1;
 
-    return prettyFunction.substr(begin,end).c_str();
+    size_t length = std::min<size_t>(end - begin, sizeof(name) - 1);
+    memcpy(name, begin, length);
+    name[length] = 0;
+    return name;
 }
 
-#ifdef USE_RDK_LOGGER
+// Call sites are told apart by their format strings, sharing a slot
+// or racing updates only make the limit approximate
+struct RateLimit {
+    std::atomic<const char*> format;
+    std::atomic<int64_t> second;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> suppressed;
+};
+static RateLimit gRateLimits[RATE_LIMIT_SLOTS];
 
-void logger_init()
+static bool rateLimited(LogLevel level, const char* format, uint32_t &suppressed)
 {
-    sync_stdout();
-    TTS_logger_init("/etc/debug.ini");
+    suppressed = 0;
+    if (!gRateLimit || level <= ERROR_LEVEL)
+        return false;
+
+    RateLimit &limit = gRateLimits[((uintptr_t)format >> 3) % RATE_LIMIT_SLOTS];
+    int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (limit.second.load(std::memory_order_relaxed) != second ||
+        limit.format.load(std::memory_order_relaxed) != format) {
+        bool sameCallSite = (limit.format.exchange(format) == format);
+        limit.second.store(second);
+        limit.count.store(0);
+        uint32_t count = limit.suppressed.exchange(0);
+        if (sameCallSite)
+            suppressed = count;
+    }
+
+    if (limit.count.fetch_add(1, std::memory_order_relaxed) < gRateLimit)
+        return false;
+
+    limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
 
-void log(LogLevel level,
+// Calls f(format, count) for the call sites which have been suppressing messages
+// since an earlier second (or at all, when "all" is set), as they may not log again
+template<typename F>
+static void takeSuppressed(bool all, F f)
+{
+    int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    for (size_t i = 0; i < RATE_LIMIT_SLOTS; ++i) {
+        RateLimit &limit = gRateLimits[i];
+        if (!limit.suppressed.load(std::memory_order_relaxed))
+            continue;
+        if (!all && limit.second.load(std::memory_order_relaxed) == second)
+            continue;
+
+        const char* format = limit.format.load(std::memory_order_relaxed);
+        uint32_t count = limit.suppressed.exchange(0);
+        if (count && format)
+            f(format, count);
+    }
+}
+
+// Formats the line of the backend (w/o the trailing new line) in one pass
+static void formatMessage(char* buffer, size_t size, LogLevel level,
     const char* func,
     const char* file,
     int line,
-    int, // thread id is already handled by TTS_logger
-    const char* format, ...)
+    int threadID,
+    uint32_t suppressed,
+    const char* format, va_list args)
 {
-    const TTS_LogLevel levelMap[] =
-        {TTS_LOG_FATAL, TTS_LOG_ERROR, TTS_LOG_WARN, TTS_LOG_INFO, TTS_LOG_DEBUG, TTS_LOG_TRACE1};
+    int length;
+    buffer[0] = 0;
 
-    const short kFormatMessageSize = 4096;
-    // TTSLogger is backed with log4c which has its own default level
-    // for filtering messages. Therefore, we don't check level here.
-    char userFormatted[kFormatMessageSize];
-    char finalFormatted[kFormatMessageSize];
+#ifdef USE_RDK_LOGGER
+    (void)level;
+    (void)threadID; // thread id is already handled by TTS_logger
+    length = snprintf(buffer, size, "%s:%s:%d ", func, basename(file), line);
+#else
+    const char* levelMap[] = {"Fatal", "Error", "Warning", "Info", "Verbose", "Trace"};
+    char timestamp[0xFF] = {0};
+    struct timespec spec;
+    struct tm tm;
 
+    clock_gettime(CLOCK_REALTIME, &spec);
+    gmtime_r(&spec.tv_sec, &tm);
+    long ms = spec.tv_nsec / 1.0e6;
+
+    sprintf(timestamp, "%02d%02d%02d-%02d:%02d:%02d.%03ld",
+        tm.tm_year % 100,
+        tm.tm_mon + 1,
+        tm.tm_mday,
+        tm.tm_hour,
+        tm.tm_min,
+        tm.tm_sec,
+        ms);
+
+    if (threadID)
+    {
+        length = snprintf(buffer, size, "%s [%s] [tid=%d] %s:%s:%d ",
+            timestamp,
+            levelMap[static_cast<int>(level)],
+            threadID,
+            func, basename(file), line);
+    }
+    else
+    {
+        length = snprintf(buffer, size, "%s [%s] %s:%s:%d ",
+            timestamp,
+            levelMap[static_cast<int>(level)],
+            func, basename(file), line);
+    }
+#endif
+
+    if (length < 0 || (size_t)length >= size)
+        return;
+
+    // A message longer than the buffer is cut, with a mark telling so
+    int messageLength = vsnprintf(buffer + length, size - length, format, args);
+    if (messageLength >= 0 && (size_t)(length + messageLength) >= size) {
+        if (size > sizeof(LOG_TRUNCATION_MARK))
+            memcpy(buffer + size - sizeof(LOG_TRUNCATION_MARK), LOG_TRUNCATION_MARK, sizeof(LOG_TRUNCATION_MARK));
+        return;
+    }
+    if (messageLength < 0)
+        return;
+
+    if (suppressed)
+        snprintf(buffer + length + messageLength, size - length - messageLength,
+            " (%u similar messages suppressed)", suppressed);
+}
+
+static void formatNotice(char* buffer, size_t size, LogLevel level,
+    const char* func,
+    const char* file,
+    int line,
+    const char* format, ...)
+{
     va_list argptr;
     va_start(argptr, format);
-    vsnprintf(userFormatted, kFormatMessageSize, format, argptr);
-    snprintf(finalFormatted, kFormatMessageSize, "%s:%s:%d %s", func,
-        basename(file),
-        line,
-        userFormatted);
+    formatMessage(buffer, size, level, func, file, line, syscall(__NR_gettid), 0, format, argptr);
     va_end(argptr);
+}
+
+static void writeMessage(LogLevel level, const char* message)
+{
+#ifdef USE_RDK_LOGGER
+    const TTS_LogLevel levelMap[] =
+        {TTS_LOG_FATAL, TTS_LOG_ERROR, TTS_LOG_WARN, TTS_LOG_INFO, TTS_LOG_DEBUG, TTS_LOG_TRACE1};
 
     // Currently, we use customized layout 'comcast_dated_nocr' in log4c.
     // This layout doesn't have trailing carriage return, so we need
@@ -84,23 +232,174 @@ void log(LogLevel level,
     RDK_LOG(levelMap[static_cast<int>(level)],
       "LOG.RDK.TTS",
       "%s\n",
-      finalFormatted);
+      message);
+#else
+    (void)level;
+    printf("%s\n", message);
+#endif
+}
 
-    if (FATAL_LEVEL == level)
-        std::abort();
+static inline void flushMessages()
+{
+#ifndef USE_RDK_LOGGER
+    fflush(stdout);
+#endif
 }
 
-#else
+/**
+ * Bounded multi producer / multi consumer ring of formatted messages.
+ * Producers never block, push() fails when the ring is full.
+ * Created by logger_init() & never destroyed, the writer runs till the process exits.
+ */
+class AsyncLog {
+public:
+    AsyncLog() : m_enqueuePos(0), m_dequeuePos(0), m_dropped(0), m_writerSleeping(false) {
+        for (size_t i = 0; i < LOG_RING_SLOTS; ++i)
+            m_records[i].sequence.store(i, std::memory_order_relaxed);
+        m_writerThread = new std::thread(WriterThreadFunc, this);
+    }
+
+    bool push(LogLevel level,
+        const char* func,
+        const char* file,
+        int line,
+        int threadID,
+        uint32_t suppressed,
+        const char* format, va_list args)
+    {
+        size_t position = m_enqueuePos.load(std::memory_order_relaxed);
+        Record *record;
+        while (true) {
+            record = &m_records[position & (LOG_RING_SLOTS - 1)];
+            intptr_t diff = (intptr_t)record->sequence.load(std::memory_order_acquire) - (intptr_t)position;
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        record->level = level;
+        formatMessage(record->message, LOG_RECORD_SIZE, level, func, file, line, threadID, suppressed, format, args);
+        record->sequence.store(position + 1, std::memory_order_release);
+
+        // Wake the writer up, if it went idle
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_writerSleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_condition.notify_one();
+        }
+        return true;
+    }
+
+    void dropped() { m_dropped.fetch_add(1, std::memory_order_relaxed); }
+
+    // Writes out all the queued messages, on the writer or on the caller's thread,
+    // with the suppressed counts of the call sites gone quiet (of all of them, if "all")
+    void drain(bool all = false) {
+        while (writeOne());
 
-static int gDefaultLogLevel = INFO_LEVEL;
-// static int gDefaultLogLevel = VERBOSE_LEVEL;
+        char message[256];
+        uint32_t dropped = m_dropped.exchange(0);
+        if (dropped) {
+            formatNotice(message, sizeof(message), WARNING_LEVEL, __func__, __FILE__, __LINE__,
+                "%u log messages were dropped, the log writer fell behind", dropped);
+            writeMessage(WARNING_LEVEL, message);
+        }
+
+        const char* func = __func__;
+        takeSuppressed(all, [&message, func](const char* format, uint32_t count) {
+            formatNotice(message, sizeof(message), WARNING_LEVEL, func, __FILE__, __LINE__,
+                "%u similar messages suppressed (\"%.96s\")", count, format);
+            writeMessage(WARNING_LEVEL, message);
+        });
+        flushMessages();
+    }
+
+private:
+    struct Record {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        char message[LOG_RECORD_SIZE];
+    };
+
+    Record m_records[LOG_RING_SLOTS];
+    std::atomic<size_t> m_enqueuePos;
+    std::atomic<size_t> m_dequeuePos;
+    std::atomic<uint32_t> m_dropped;
+
+    std::atomic<bool> m_writerSleeping;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread *m_writerThread;
+
+    bool hasPending() {
+        size_t position = m_dequeuePos.load(std::memory_order_relaxed);
+        return m_records[position & (LOG_RING_SLOTS - 1)].sequence.load(std::memory_order_acquire) == position + 1;
+    }
+
+    bool writeOne() {
+        size_t position = m_dequeuePos.load(std::memory_order_relaxed);
+        Record *record;
+        while (true) {
+            record = &m_records[position & (LOG_RING_SLOTS - 1)];
+            intptr_t diff = (intptr_t)record->sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1);
+            if (diff == 0) {
+                if (m_dequeuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        writeMessage(record->level, record->message);
+        record->sequence.store(position + LOG_RING_SLOTS, std::memory_order_release);
+        return true;
+    }
+
+    static void WriterThreadFunc(void *ctx) {
+        AsyncLog *self = (AsyncLog*)ctx;
+        while (true) {
+            self->drain();
+
+            std::unique_lock<std::mutex> lock(self->m_mutex);
+            self->m_writerSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!self->hasPending())
+                self->m_condition.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_IDLE_MS));
+            self->m_writerSleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+};
+
+static std::atomic<AsyncLog*> gAsyncLog(NULL);
 
 void logger_init()
 {
     sync_stdout();
+#ifdef USE_RDK_LOGGER
+    TTS_logger_init("/etc/debug.ini");
+#endif
+
     const char* level = getenv("TTS_DEFAULT_LOG_LEVEL");
     if (level)
-        gDefaultLogLevel = static_cast<LogLevel>(atoi(level));
+        gLogLevel = atoi(level);
+
+    const char* rateLimit = getenv("TTS_LOG_RATE_LIMIT");
+    if (rateLimit)
+        gRateLimit = atoi(rateLimit);
+
+    // Synchronous output was asked for, leave the writes to the callers
+    if (getenv("SYNC_STDOUT") || getenv("TTS_SYNC_LOGGING") || gAsyncLog.load())
+        return;
+
+    gAsyncLog = new AsyncLog;
+    atexit([]() { gAsyncLog.load()->drain(true); });
 }
 
 void log(LogLevel level,
@@ -110,60 +409,38 @@ void log(LogLevel level,
     int threadID,
     const char* format, ...)
 {
-    if (gDefaultLogLevel < level)
+    if (!isLogEnabled(level))
         return;
 
-    const char* levelMap[] = {"Fatal", "Error", "Warning", "Info", "Verbose", "Trace"};
-    const short kFormatMessageSize = 4096;
-    char formatted[kFormatMessageSize];
+    uint32_t suppressed = 0;
+    if (rateLimited(level, format, suppressed))
+        return;
 
     va_list argptr;
     va_start(argptr, format);
-    vsnprintf(formatted, kFormatMessageSize, format, argptr);
-    va_end(argptr);
 
-    char timestamp[0xFF] = {0};
-    struct timespec spec;
-    struct tm tm;
+    AsyncLog *asyncLog = gAsyncLog.load(std::memory_order_acquire);
+    bool queued = false;
+    if (asyncLog && level != FATAL_LEVEL)
+        queued = asyncLog->push(level, func, file, line, threadID, suppressed, format, argptr);
 
-    clock_gettime(CLOCK_REALTIME, &spec);
-    gmtime_r(&spec.tv_sec, &tm);
-    long ms = spec.tv_nsec / 1.0e6;
+    // Errors aren't lost to a full ring & a fatal message comes after the queued ones
+    if (!queued && asyncLog && level > ERROR_LEVEL) {
+        asyncLog->dropped();
+    } else if (!queued) {
+        if (asyncLog && FATAL_LEVEL == level)
+            asyncLog->drain();
 
-    sprintf(timestamp, "%02d%02d%02d-%02d:%02d:%02d.%03ld",
-        tm.tm_year % 100,
-        tm.tm_mon + 1,
-        tm.tm_mday,
-        tm.tm_hour,
-        tm.tm_min,
-        tm.tm_sec,
-        ms);
-
-    if (threadID)
-    {
-        printf("%s [%s] [tid=%d] %s:%s:%d %s\n",
-            timestamp,
-            levelMap[static_cast<int>(level)],
-            threadID,
-            func, basename(file), line,
-            formatted);
-    }
-    else
-    {
-        printf("%s [%s] %s:%s:%d %s\n",
-            timestamp,
-            levelMap[static_cast<int>(level)],
-            func, basename(file), line,
-            formatted);
+        const short kFormatMessageSize = 4096;
+        char formatted[kFormatMessageSize];
+        formatMessage(formatted, kFormatMessageSize, level, func, file, line, threadID, suppressed, format, argptr);
+        writeMessage(level, formatted);
+        flushMessages();
     }
-
-    fflush(stdout);
+    va_end(argptr);
 
     if (FATAL_LEVEL == level)
-      std::abort();
+        std::abort();
 }
 
-#endif // USE_TTS_LOGGER
-
-
 } // namespace TTS
@@ -21,6 +21,7 @@
 
 #include <iostream>
 #include <string>
+#include <atomic>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -28,7 +29,8 @@
 
 namespace TTS {
 
-const char* methodName(const std::string& prettyFunction);
+// Returns the "Class::method" part of the pretty function, valid till the next call from the thread
+const char* methodName(const char* prettyFunction);
 #define __METHOD_NAME__ TTS::methodName(__PRETTY_FUNCTION__)
 
 /**
@@ -39,12 +41,31 @@ const char* methodName(const std::string& prettyFunction);
  */
 enum LogLevel {FATAL_LEVEL = 0, ERROR_LEVEL, WARNING_LEVEL, INFO_LEVEL, VERBOSE_LEVEL, TRACE_LEVEL};
 
+/**
+ * Messages finer than TTS_LOG_COMPILE_LEVEL are compiled out
+ * (cmake -DTTS_LOG_COMPILE_LEVEL=<level>), by default nothing is.
+ */
+#ifndef TTS_LOG_COMPILE_LEVEL
+#define TTS_LOG_COMPILE_LEVEL 5 // TRACE_LEVEL
+#endif
+
 /**
  * @brief Init logging
- * Should be called once per program run before calling log-functions
+ * Should be called once per program run before calling log-functions.
+ * Starts the background writer, unless SYNC_STDOUT or TTS_SYNC_LOGGING is set.
  */
 void logger_init();
 
+/**
+ * @brief Check whether a message of the level would be logged
+ * Lets the log macros skip formatting (& evaluating the arguments of) the filtered messages
+ */
+extern std::atomic<int> gLogLevel;
+inline bool isLogEnabled(LogLevel level)
+{
+    return level <= TTS_LOG_COMPILE_LEVEL && level <= gLogLevel.load(std::memory_order_relaxed);
+}
+
 
 #define TTS_assert(expr) do { \
                               if ( __builtin_expect(expr, true) ) \
@@ -58,6 +79,10 @@ void logger_init();
  * The function is defined by logging backend.
  * Currently 2 variants are supported: TTS_logger (USE_TTS_LOGGER),
  *                                     stdout(default)
+ * Once logger_init() is done, the message is formatted into a ring buffer
+ * & written by a background thread (Fatal ones are written right away).
+ * A call site logging more than TTS_LOG_RATE_LIMIT Warning / Info / Verbose / Trace
+ * messages in a second is suppressed for the rest of that second.
  */
 void log(LogLevel level,
     const char* func,
@@ -68,16 +93,22 @@ void log(LogLevel level,
 
 #ifdef USE_RDK_LOGGER
 #define _LOG(LEVEL, FORMAT, ...)          \
-    TTS::log(LEVEL,                       \
-         __func__, __FILE__, __LINE__, 0, \
-         FORMAT,                          \
-         ##__VA_ARGS__)
+    do {                                  \
+        if (TTS::isLogEnabled(LEVEL))     \
+            TTS::log(LEVEL,               \
+                 __func__, __FILE__, __LINE__, 0, \
+                 FORMAT,                  \
+                 ##__VA_ARGS__);          \
+    } while (0)
 #else
 #define _LOG(LEVEL, FORMAT, ...)          \
-    TTS::log(LEVEL,                       \
-         __func__, __FILE__, __LINE__, syscall(__NR_gettid), \
-         FORMAT,                          \
-         ##__VA_ARGS__)
+    do {                                  \
+        if (TTS::isLogEnabled(LEVEL))     \
+            TTS::log(LEVEL,               \
+                 __func__, __FILE__, __LINE__, syscall(__NR_gettid), \
+                 FORMAT,                  \
+                 ##__VA_ARGS__);          \
+    } while (0)
 #endif
 
 #define TTSLOG_TRACE(FMT, ...)   _LOG(TTS::TRACE_LEVEL, FMT, ##__VA_ARGS__)
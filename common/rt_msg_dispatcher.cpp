@@ -16,53 +16,116 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
 */
-#ifndef _RT_REMOTE_MESSAGE_DISPATCHER_H_
-#define _RT_REMOTE_MESSAGE_DISPATCHER_H_
-
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 
 #include <rtRemote.h>
 
+#include <mutex>
+
 #include "logger.h"
 #include "glib_utils.h"
 #include "rt_msg_dispatcher.h"
 
 namespace TTS {
 
+#define DEFAULT_RT_DISPATCH_BUDGET_MS 5
+
+struct RtDispatcher {
+    int fd;
+    gint64 budgetUs;
+};
+
+static std::mutex gStatisticsMutex;
+static RtDispatchStatistics gStatistics;
+
 void processMessageInMainLoop(void*, void *data) {
-    static char discard[1];
-    if(data) {
-        int ret = HANDLE_EINTR_EAGAIN(read(*(int*)data, discard, 1));
-        if (-1 == ret) {
-            TTSLOG_ERROR("unable to read from pipe");
-        }
+    RtDispatcher *dispatcher = (RtDispatcher*)data;
+    if(!dispatcher)
+        return;
 
+    // Resets the counter, the messages queued from here on wake the loop up again
+    eventfd_t count = 0;
+    if (eventfd_read(dispatcher->fd, &count) == -1 && errno != EAGAIN && errno != EINTR) {
+        TTSLOG_ERROR("unable to read from eventfd");
+    }
+
+    uint32_t items = 0;
+    bool exceeded = false;
+    gint64 deadline = g_get_monotonic_time() + dispatcher->budgetUs;
+    while(true) {
         rtError err = rtRemoteProcessSingleItem();
         if (err == RT_ERROR_QUEUE_EMPTY) {
-            TTSLOG_TRACE("queue was empty upon processing event");
+            if(items == 0)
+                TTSLOG_TRACE("queue was empty upon processing event");
+            break;
+        }
+        items++;
+
+        // Leave the rest for the next iteration of the loop
+        if(g_get_monotonic_time() >= deadline) {
+            exceeded = true;
+            eventfd_write(dispatcher->fd, 1);
+            break;
         }
     }
+
+    std::lock_guard<std::mutex> lock(gStatisticsMutex);
+    gStatistics.wakeups++;
+    gStatistics.items += items;
+    if(items > gStatistics.maxItems)
+        gStatistics.maxItems = items;
+    if(exceeded)
+        gStatistics.budgetExceeded++;
 }
 
 void rtRemoteQueueReadyHandler(void *data)
 {
-    static char temp[1];
-    if(data) {
-        int ret = HANDLE_EINTR_EAGAIN(write(*(int*)data, temp, 1));
+    RtDispatcher *dispatcher = (RtDispatcher*)data;
+    if(dispatcher) {
+        int ret = HANDLE_EINTR_EAGAIN(eventfd_write(dispatcher->fd, 1));
         if (ret == -1)
-            TTSLOG_ERROR("can't write to pipe");
+            TTSLOG_ERROR("can't write to eventfd");
     }
 }
 
-GSource *installRtRemoteMessageHandler(int pipefd[2], GMainContext* context) {
-    GSource *source = create_and_setup_source(pipefd[PIPE_LISTEN], processMessageInMainLoop, NullCB, &pipefd[PIPE_LISTEN]);
+GSource *installRtRemoteMessageHandler(GMainContext* context) {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fd == -1) {
+        TTSLOG_ERROR("Can't create eventfd, can't install rtRemoteQueueReadyHandler");
+        return NULL;
+    }
+
+    RtDispatcher *dispatcher = new RtDispatcher;
+    dispatcher->fd = fd;
+    dispatcher->budgetUs = 1000 * ((getenv("TTS_RT_DISPATCH_BUDGET_MS") && atoi(getenv("TTS_RT_DISPATCH_BUDGET_MS")) > 0) ?
+        atoi(getenv("TTS_RT_DISPATCH_BUDGET_MS")) : DEFAULT_RT_DISPATCH_BUDGET_MS);
+
+    GSource *source = create_and_setup_source(fd, processMessageInMainLoop, NullCB, dispatcher);
     g_source_attach(source, context);
-    rtRemoteRegisterQueueReadyHandler(rtEnvironmentGetGlobal(), rtRemoteQueueReadyHandler, &pipefd[PIPE_WRITE]);
+    rtRemoteRegisterQueueReadyHandler(rtEnvironmentGetGlobal(), rtRemoteQueueReadyHandler, dispatcher);
     return source;
 }
 
-} // namespace TTS
+void uninstallRtRemoteMessageHandler(GSource *source) {
+    if(!source)
+        return;
+
+    rtRemoteRegisterQueueReadyHandler(rtEnvironmentGetGlobal(), NULL, NULL);
 
-#endif
+    RtDispatcher *dispatcher = (RtDispatcher*)((EventSource*)source)->ctx;
+    g_source_destroy(source);
+    g_source_unref(source);
+    close(dispatcher->fd);
+    delete dispatcher;
+}
+
+RtDispatchStatistics rtRemoteDispatchStatistics() {
+    std::lock_guard<std::mutex> lock(gStatisticsMutex);
+    return gStatistics;
+}
+
+} // namespace TTS
@@ -20,12 +20,27 @@
 #define _RT_REMOTE_MESSAGE_DISPATCHER_H_
 
 #include <glib.h>
+#include <stdint.h>
 
 namespace TTS {
 
+// rtRemote messages are dispatched on the given main context. The queued messages are counted
+// on an eventfd & every wakeup processes all of them, within a time budget (TTS_RT_DISPATCH_BUDGET_MS
+// environment variable, default 5ms) so that the main loop stays responsive.
+struct RtDispatchStatistics {
+    RtDispatchStatistics() : wakeups(0), items(0), maxItems(0), budgetExceeded(0) {}
+
+    uint64_t wakeups;
+    uint64_t items;             // Messages processed
+    uint32_t maxItems;          // Most messages processed in a wakeup
+    uint64_t budgetExceeded;    // Wakeups which left messages for the next one
+};
+
 void processMessageInMainLoop(void *context, void *data);
 void rtRemoteQueueReadyHandler(void *data);
-GSource* installRtRemoteMessageHandler(int pipefd[2], GMainContext* context);
+GSource* installRtRemoteMessageHandler(GMainContext* context);
+void uninstallRtRemoteMessageHandler(GSource *source);
+RtDispatchStatistics rtRemoteDispatchStatistics();
 
 } // namespace TTS
 
@@ -214,6 +214,9 @@ private:
 #define OPT_EXIT                21
 #define OPT_BLOCK_TILL_INPUT    22
 #define OPT_SLEEP               23
+#define OPT_SET_PRIORITY        24
+#define OPT_SPEAK_BATCH         25
+#define OPT_SPEAK_ASYNC         26
 
 int main(int argc, char *argv[]) {
     std::map<uint32_t, AppInfo*> appInfoMap;
@@ -266,6 +269,9 @@ int main(int argc, char *argv[]) {
                     cout << OPT_EXIT                << ".exit" << endl;
                     cout << OPT_BLOCK_TILL_INPUT    << ".dummyInput" << endl;
                     cout << OPT_SLEEP               << ".sleep" << endl;
+                    cout << OPT_SET_PRIORITY        << ".setPriority" << endl;
+                    cout << OPT_SPEAK_BATCH         << ".speakBatch" << endl;
+                    cout << OPT_SPEAK_ASYNC         << ".speakAsync" << endl;
                     cout << "------------------------" << endl;
                 } else {
                     cout << endl;
@@ -281,7 +287,7 @@ int main(int argc, char *argv[]) {
                 cin.ignore();
                 counter = 1;
             }
-        } while(g_connectedToTTS && !(choice >= OPT_ENABLE_TTS && choice <= OPT_SLEEP));
+        } while(g_connectedToTTS && !(choice >= OPT_ENABLE_TTS && choice <= OPT_SPEAK_ASYNC));
 
         bool res = 0;
         int sid = 0;
@@ -528,6 +534,60 @@ int main(int argc, char *argv[]) {
             stream.getInput(appid, "Enter delay (in secs) : ");
             sleep(appid);
             break;
+
+            case OPT_SET_PRIORITY:
+                stream.getInput(appid, "Enter app id : ");
+                if(appInfoMap.find(appid) != appInfoMap.end()) {
+                    uint32_t priority = 0;
+                    stream.getInput(priority, "Enter priority [0-3] : ");
+                    sessionid = appInfoMap.find(appid)->second->m_sessionId;
+                    error = client->setPriority(sessionid, (uint8_t)priority);
+                    validateReturn(error, 0);
+                } else {
+                    cout << "Session hasn't been created for app(" << appid << ")" << endl;
+                }
+                break;
+
+            case OPT_SPEAK_BATCH:
+                stream.getInput(appid, "Enter app id : ");
+                if(appInfoMap.find(appid) != appInfoMap.end()) {
+                    uint32_t count = 0;
+                    std::vector<SpeechData> speeches;
+                    sessionid = appInfoMap.find(appid)->second->m_sessionId;
+                    stream.getInput(secure, "Secure/Plain Transfer [0/1] : ");
+                    stream.getInput(sid, "Speech Id of the first text (int) : ");
+                    stream.getInput(count, "Number of texts : ");
+                    for(uint32_t i = 0; i < count; ++i) {
+                        stream.getInput(stext, "Enter text to be spoken : ");
+                        speeches.push_back(SpeechData(sid + i));
+                        speeches.back().secure = secure;
+                        speeches.back().text = stext;
+                    }
+                    error = client->speakBatch(sessionid, speeches);
+                    validateReturn(error, 100);
+                } else {
+                    cout << "Session hasn't been created for app(" << appid << ")" << endl;
+                }
+                break;
+
+            case OPT_SPEAK_ASYNC:
+                stream.getInput(appid, "Enter app id : ");
+                if(appInfoMap.find(appid) != appInfoMap.end()) {
+                    sessionid = appInfoMap.find(appid)->second->m_sessionId;
+                    stream.getInput(secure, "Secure/Plain Transfer [0/1] : ");
+                    stream.getInput(sid, "Speech Id (int) : ");
+                    stream.getInput(stext, "Enter text to be spoken : ");
+                    sdata.secure = secure;
+                    sdata.id = sid;
+                    sdata.text = stext;
+                    error = client->speakAsync(sessionid, sdata, [sid] (TTS_Error result) {
+                        cout << "speakAsync(" << sid << ") completed with code (" << result << ")" << endl;
+                    });
+                    validateReturn(error, 0);
+                } else {
+                    cout << "Session hasn't been created for app(" << appid << ")" << endl;
+                }
+                break;
         }
     }
 
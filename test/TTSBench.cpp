@@ -0,0 +1,732 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+// Offline benchmark of TTSEngine.
+//
+// Runs a local HTTP server which stands in for the TTS endpoint (canned / generated
+// audio, with injected latency, bandwidth limit & errors), points TTSEngine to it
+// through TTSClient, runs the scripted workloads and reports the measurements as JSON.
+
+#include "TTSClient.h"
+#include "logger.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <list>
+#include <map>
+
+// --- //
+
+#define EVENT_TIMEOUT_SECS 30
+#define SAMPLE_RATE 16000
+#define MS_PER_CHARACTER 60
+#define MIN_PLAYED_RATIO 0.9    // Of the generated audio, for a speech to count as fully played
+
+// --- //
+
+using namespace TTS;
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+struct BenchOptions {
+    BenchOptions() :
+        port(0),
+        latencyMs(0),
+        bandwidth(0),
+        errorRate(0),
+        count(10),
+        warmCache(0),
+        workloads("sequential,queue,batch,cancel"),
+        output("-") {
+        }
+
+    int port;
+    int latencyMs;      // Delay before the response
+    int bandwidth;      // Bytes per second, 0 - unlimited
+    int errorRate;      // Percentage of requests failed with HTTP 500
+    int count;          // Speeches per workload
+    int warmCache;      // Repeat the same texts, so that TTSEngine may serve them from cache
+    std::string engine; // TTSEngine binary to launch, otherwise a running one is used
+    std::string canned; // File with "text<TAB>audio file" lines
+    std::string workloads;
+    std::string output;
+};
+
+// --- //
+
+// Stand-in synthesis endpoint
+class StandInEndpoint {
+public:
+    StandInEndpoint(BenchOptions &options) :
+        m_options(options),
+        m_socket(-1),
+        m_port(0),
+        m_running(false),
+        m_thread(NULL),
+        m_requests(0),
+        m_errors(0),
+        m_bytes(0),
+        m_audioMs(0) {
+        loadCanned();
+    }
+
+    ~StandInEndpoint() { stop(); }
+
+    bool start() {
+        m_socket = socket(AF_INET, SOCK_STREAM, 0);
+        if(m_socket < 0)
+            return false;
+
+        int on = 1;
+        setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(m_options.port);
+        socklen_t len = sizeof(addr);
+        if(bind(m_socket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_socket, 16) != 0 ||
+            getsockname(m_socket, (struct sockaddr*)&addr, &len) != 0) {
+            TTSLOG_ERROR("Couldn't start the stand-in endpoint, %s", strerror(errno));
+            close(m_socket);
+            m_socket = -1;
+            return false;
+        }
+
+        m_port = ntohs(addr.sin_port);
+        m_running = true;
+        m_thread = new std::thread(AcceptThreadFunc, this);
+        TTSLOG_INFO("Stand-in endpoint is listening on port %d", m_port);
+        return true;
+    }
+
+    void stop() {
+        if(!m_running)
+            return;
+
+        m_running = false;
+        shutdown(m_socket, SHUT_RDWR);
+        close(m_socket);
+        m_thread->join();
+        delete m_thread;
+        m_thread = NULL;
+    }
+
+    std::string url() { return "http://127.0.0.1:" + std::to_string(m_port) + "/tts?"; }
+    uint64_t requests() { return m_requests; }
+    uint64_t errors() { return m_errors; }
+    uint64_t bytes() { return m_bytes; }
+    uint64_t audioMs() { return m_audioMs; }   // Duration of the generated audio served
+
+private:
+    BenchOptions &m_options;
+    int m_socket;
+    int m_port;
+    std::atomic<bool> m_running;
+    std::thread *m_thread;
+    std::atomic<uint64_t> m_requests;
+    std::atomic<uint64_t> m_errors;
+    std::atomic<uint64_t> m_bytes;
+    std::atomic<uint64_t> m_audioMs;
+    std::map<std::string, std::string> m_canned;
+
+    void loadCanned() {
+        if(m_options.canned.empty())
+            return;
+
+        std::ifstream list(m_options.canned);
+        std::string line;
+        while(std::getline(list, line)) {
+            size_t tab = line.find('\t');
+            if(tab == std::string::npos)
+                continue;
+
+            std::ifstream audio(line.substr(tab + 1), std::ios::binary);
+            std::stringstream ss;
+            ss << audio.rdbuf();
+            m_canned[line.substr(0, tab)] = ss.str();
+        }
+        TTSLOG_INFO("Loaded %zu canned clips", m_canned.size());
+    }
+
+    static std::string urlDecode(const std::string &in) {
+        std::string out;
+        for(size_t i = 0; i < in.length(); ++i) {
+            if(in[i] == '%' && i + 2 < in.length()) {
+                out += (char)strtol(in.substr(i + 1, 2).c_str(), NULL, 16);
+                i += 2;
+            } else {
+                out += (in[i] == '+') ? ' ' : in[i];
+            }
+        }
+        return out;
+    }
+
+    // Mono 16bit WAV of a tone, as long as the text would take to speak
+    static std::string generateAudio(const std::string &text, std::string &type) {
+        uint32_t samples = (text.length() * MS_PER_CHARACTER) * SAMPLE_RATE / 1000;
+        uint32_t dataSize = samples * 2;
+
+        std::string wav;
+        auto put32 = [&wav] (uint32_t v) { wav.append((const char*)&v, 4); };
+        auto put16 = [&wav] (uint16_t v) { wav.append((const char*)&v, 2); };
+        wav.append("RIFF"); put32(36 + dataSize); wav.append("WAVE");
+        wav.append("fmt "); put32(16); put16(1); put16(1); put32(SAMPLE_RATE); put32(SAMPLE_RATE * 2); put16(2); put16(16);
+        wav.append("data"); put32(dataSize);
+        for(uint32_t i = 0; i < samples; ++i)
+            put16((int16_t)(((i / (SAMPLE_RATE / 440 / 2)) % 2) ? 2000 : -2000));
+
+        type = "audio/x-wav";
+        return wav;
+    }
+
+    bool sendAll(int fd, const char *data, size_t size) {
+        // Throttle to the configured bandwidth in 10ms slices
+        size_t slice = m_options.bandwidth > 0 ? std::max(1, m_options.bandwidth / 100) : size;
+        while(size > 0) {
+            ssize_t sent = send(fd, data, std::min(slice, size), MSG_NOSIGNAL);
+            if(sent <= 0)
+                return false;
+            data += sent;
+            size -= sent;
+            m_bytes += sent;
+            if(m_options.bandwidth > 0 && size > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        char data[4096];
+
+        // Keep-alive, serve the requests until the client closes the connection
+        while(m_running) {
+            size_t end;
+            while((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = recv(fd, data, sizeof(data), 0);
+                if(n <= 0) {
+                    close(fd);
+                    return;
+                }
+                buffer.append(data, n);
+            }
+            std::string request = buffer.substr(0, end);
+            buffer.erase(0, end + 4);
+            m_requests++;
+
+            std::string target = request.substr(0, request.find("\r\n"));
+            std::string text;
+            size_t pos = target.find("text=");
+            if(pos != std::string::npos)
+                text = urlDecode(target.substr(pos + 5, target.find_first_of(" &", pos) - pos - 5));
+
+            if(m_options.latencyMs > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(m_options.latencyMs));
+
+            if(m_options.errorRate > 0 && (rand() % 100) < m_options.errorRate) {
+                m_errors++;
+                const char *response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+                if(!sendAll(fd, response, strlen(response)))
+                    break;
+                continue;
+            }
+
+            std::string type = "audio/mpeg";
+            auto it = m_canned.find(text);
+            std::string body = (it != m_canned.end()) ? it->second : generateAudio(text, type);
+            if(it == m_canned.end())
+                m_audioMs += text.length() * MS_PER_CHARACTER;
+
+            std::string header = "HTTP/1.1 200 OK\r\nContent-Type: " + type +
+                "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: keep-alive\r\n\r\n";
+            if(!sendAll(fd, header.data(), header.size()) || !sendAll(fd, body.data(), body.size()))
+                break;
+        }
+        close(fd);
+    }
+
+    static void AcceptThreadFunc(void *ctx) {
+        StandInEndpoint *endpoint = (StandInEndpoint*)ctx;
+        std::list<std::thread*> connections;
+
+        while(endpoint->m_running) {
+            int fd = accept(endpoint->m_socket, NULL, NULL);
+            if(fd < 0)
+                continue;
+            connections.push_back(new std::thread(&StandInEndpoint::serve, endpoint, fd));
+        }
+
+        for(auto it = connections.begin(); it != connections.end(); ++it) {
+            (*it)->detach();
+            delete *it;
+        }
+    }
+};
+
+// --- //
+
+struct SpeechEvents {
+    Clock::time_point requested;
+    Clock::time_point started;
+    Clock::time_point completed;
+    Clock::time_point interrupted;
+    bool hasStarted = false;
+    bool hasCompleted = false;
+    bool hasInterrupted = false;
+    bool failed = false;
+};
+
+std::mutex g_mutex;
+std::condition_variable g_condition;
+std::map<uint32_t, SpeechEvents> g_events;
+bool g_connectedToTTS = false;
+GMainLoop *g_loop = NULL;
+
+class BenchConnectionCallback : public TTSConnectionCallback {
+public:
+    virtual void onTTSServerConnected() {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_connectedToTTS = true;
+        g_condition.notify_all();
+    }
+
+    virtual void onTTSServerClosed() {
+        TTSLOG_ERROR("Connection to TTSEngine got closed");
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_connectedToTTS = false;
+        g_condition.notify_all();
+    }
+};
+
+class BenchSessionCallback : public TTSSessionCallback {
+public:
+    virtual void onSpeechStart(uint32_t, uint32_t, SpeechData &data) { update(data.id, [] (SpeechEvents &e) { e.started = Clock::now(); e.hasStarted = true; }); }
+    virtual void onSpeechComplete(uint32_t, uint32_t, SpeechData &data) { update(data.id, [] (SpeechEvents &e) { e.completed = Clock::now(); e.hasCompleted = true; }); }
+    virtual void onSpeechInterrupted(uint32_t, uint32_t, uint32_t id) { update(id, [] (SpeechEvents &e) { e.interrupted = Clock::now(); e.hasInterrupted = true; }); }
+    virtual void onSpeechCancelled(uint32_t, uint32_t, uint32_t id) { update(id, [] (SpeechEvents &e) { e.interrupted = Clock::now(); e.hasInterrupted = true; }); }
+    virtual void onNetworkError(uint32_t, uint32_t, uint32_t id) { update(id, [] (SpeechEvents &e) { e.failed = true; }); }
+    virtual void onPlaybackError(uint32_t, uint32_t, uint32_t id) { update(id, [] (SpeechEvents &e) { e.failed = true; }); }
+
+private:
+    template<typename F> void update(uint32_t id, F f) {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        f(g_events[id]);
+        g_condition.notify_all();
+    }
+};
+
+template<typename P> static bool waitFor(P predicate) {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    return g_condition.wait_for(lock, std::chrono::seconds(EVENT_TIMEOUT_SECS), predicate);
+}
+
+// --- //
+
+class Summary {
+public:
+    void add(double v) { m_values.push_back(v); }
+
+    std::string json() {
+        std::stringstream ss;
+        ss << "{\"count\": " << m_values.size();
+        if(!m_values.empty()) {
+            std::sort(m_values.begin(), m_values.end());
+            double sum = 0;
+            for(auto v : m_values)
+                sum += v;
+            ss << ", \"min\": " << m_values.front() << ", \"mean\": " << sum / m_values.size()
+                << ", \"p50\": " << at(0.50) << ", \"p95\": " << at(0.95) << ", \"max\": " << m_values.back();
+        }
+        ss << "}";
+        return ss.str();
+    }
+
+private:
+    std::vector<double> m_values;
+    double at(double q) { return m_values[std::min(m_values.size() - 1, (size_t)(q * m_values.size()))]; }
+};
+
+static const char *g_texts[] = {
+    "OK",
+    "Settings",
+    "Press the select button to continue.",
+    "Movies, TV shows and sports are available in the on demand section of the guide.",
+    "A retired detective is pulled back for one last case, when a string of burglaries across the city "
+        "turns out to be connected to an unsolved disappearance from twenty years ago. As old friends become "
+        "suspects, he must decide how much of the past he is willing to uncover.",
+};
+
+class Bench {
+public:
+    Bench(BenchOptions &options, StandInEndpoint &endpoint, TTSClient *client, uint32_t session) :
+        m_options(options), m_endpoint(endpoint), m_client(client), m_session(session), m_nextId(1), m_iteration(0), m_completed(0) {}
+
+    std::string text(int i) {
+        std::string t = g_texts[i % (sizeof(g_texts) / sizeof(g_texts[0]))];
+        // Unique texts, unless the cache is being measured
+        if(!m_options.warmCache)
+            t += " " + std::to_string(++m_iteration);
+        return t;
+    }
+
+    uint32_t speak(const std::string &text) {
+        SpeechData data;
+        data.id = m_nextId++;
+        data.text = text;
+        data.secure = false;
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_events[data.id].requested = Clock::now();
+        }
+        if(m_client->speak(m_session, data) != TTS_OK) {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_events[data.id].failed = true;
+        }
+        return data.id;
+    }
+
+    bool done(uint32_t id) {
+        SpeechEvents &e = g_events[id];
+        return e.hasCompleted || e.hasInterrupted || e.failed;
+    }
+
+    // Speak & wait for the completion, one by one. With a real time sink, the playback of a
+    // speech lasts as long as the audio generated for all its requests (segments)
+    std::string sequential() {
+        Summary ttfa, duration, played;
+        int failures = 0, shortPlaybacks = 0;
+        m_client->setPreemptiveSpeak(m_session, true);
+
+        for(int i = 0; i < m_options.count; ++i) {
+            uint64_t audioMs = m_endpoint.audioMs();
+            uint32_t id = speak(text(i));
+            waitFor([this, id] { return done(id); });
+            audioMs = m_endpoint.audioMs() - audioMs;
+
+            std::lock_guard<std::mutex> lock(g_mutex);
+            SpeechEvents &e = g_events[id];
+            if(e.hasStarted)
+                ttfa.add(msSince(e.requested, e.started));
+            if(e.hasCompleted) {
+                duration.add(msSince(e.requested, e.completed));
+                m_completed++;
+            } else {
+                failures++;
+            }
+
+            // Served from the cache / canned clips, nothing to compare with
+            if(e.hasStarted && e.hasCompleted && audioMs > 0) {
+                double ratio = msSince(e.started, e.completed) / audioMs;
+                played.add(ratio);
+                if(ratio < MIN_PLAYED_RATIO) {
+                    TTSLOG_ERROR("Speech %u played %.0fms of %llums audio", id, msSince(e.started, e.completed), (unsigned long long)audioMs);
+                    shortPlaybacks++;
+                }
+            }
+        }
+
+        return "{\"timeToFirstAudioMs\": " + ttfa.json() + ", \"requestToCompleteMs\": " + duration.json() +
+            ", \"playedToAudioRatio\": " + played.json() + ", \"shortPlaybacks\": " + std::to_string(shortPlaybacks) +
+            ", \"failures\": " + std::to_string(failures) + "}";
+    }
+
+    void speakBatch(std::vector<SpeechData> &speeches) {
+        Clock::time_point requested = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            for(auto &data : speeches)
+                g_events[data.id].requested = requested;
+        }
+        if(m_client->speakBatch(m_session, speeches) != TTS_OK) {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            for(auto &data : speeches)
+                g_events[data.id].failed = true;
+        }
+    }
+
+    // Queue all the speeches at once (non-preemptive), one by one or in a single batch,
+    // measure the time taken to queue & the gaps in between
+    std::string queue(bool batch) {
+        Summary ttfa, gap;
+        int failures = 0;
+        m_client->setPreemptiveSpeak(m_session, false);
+
+        std::vector<uint32_t> ids;
+        Clock::time_point start = Clock::now();
+        if(batch) {
+            std::vector<SpeechData> speeches;
+            for(int i = 0; i < m_options.count; ++i) {
+                speeches.push_back(SpeechData(m_nextId++));
+                speeches.back().secure = false;
+                speeches.back().text = text(i);
+                ids.push_back(speeches.back().id);
+            }
+            speakBatch(speeches);
+        } else {
+            for(int i = 0; i < m_options.count; ++i)
+                ids.push_back(speak(text(i)));
+        }
+        double enqueueMs = msSince(start, Clock::now());
+        for(auto id : ids)
+            waitFor([this, id] { return done(id); });
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for(size_t i = 0; i < ids.size(); ++i) {
+            SpeechEvents &e = g_events[ids[i]];
+            if(!e.hasCompleted) {
+                failures++;
+                continue;
+            }
+            m_completed++;
+            if(i == 0 && e.hasStarted)
+                ttfa.add(msSince(e.requested, e.started));
+            if(i > 0 && e.hasStarted && g_events[ids[i - 1]].hasCompleted)
+                gap.add(msSince(g_events[ids[i - 1]].completed, e.started));
+        }
+        m_client->setPreemptiveSpeak(m_session, true);
+
+        return "{\"enqueueMs\": " + std::to_string(enqueueMs) + ", \"timeToFirstAudioMs\": " + ttfa.json() +
+            ", \"interUtteranceGapMs\": " + gap.json() + ", \"failures\": " + std::to_string(failures) + "}";
+    }
+
+    // Abort the speech as soon as it starts
+    std::string cancel() {
+        Summary latency;
+        int failures = 0;
+        m_client->setPreemptiveSpeak(m_session, true);
+
+        for(int i = 0; i < m_options.count; ++i) {
+            uint32_t id = speak(text(sizeof(g_texts) / sizeof(g_texts[0]) - 1));
+            waitFor([this, id] { return g_events[id].hasStarted || done(id); });
+
+            Clock::time_point aborted = Clock::now();
+            m_client->abort(m_session);
+            waitFor([this, id] { return done(id); });
+
+            std::lock_guard<std::mutex> lock(g_mutex);
+            SpeechEvents &e = g_events[id];
+            if(e.hasInterrupted)
+                latency.add(msSince(aborted, e.interrupted));
+            else
+                failures++;
+        }
+
+        return "{\"cancelLatencyMs\": " + latency.json() + ", \"failures\": " + std::to_string(failures) + "}";
+    }
+
+    uint32_t completed() { return m_completed; }
+
+private:
+    BenchOptions &m_options;
+    StandInEndpoint &m_endpoint;
+    TTSClient *m_client;
+    uint32_t m_session;
+    uint32_t m_nextId;
+    uint32_t m_iteration;
+    uint32_t m_completed;
+};
+
+// --- //
+
+struct ThreadData {
+    BenchOptions options;
+    StandInEndpoint *endpoint;
+    int result;
+};
+
+void ThreadFunc(void *ctx) {
+    ThreadData &td = *(ThreadData*)ctx;
+    td.result = 1;
+
+    TTSClient *client = TTSClient::create(new BenchConnectionCallback);
+    if(!waitFor([] { return g_connectedToTTS; })) {
+        TTSLOG_ERROR("Couldn't connect to TTSEngine");
+        delete client;
+        g_main_loop_quit(g_loop);
+        return;
+    }
+
+    Configuration config;
+    config.ttsEndPoint = td.endpoint->url();
+    config.ttsEndPointSecured = td.endpoint->url();
+    config.language = "en-US";
+    config.voice = "bench";
+    client->setTTSConfiguration(config);
+    client->enableTTS(true);
+
+    uint32_t appId = 1000 + getpid() % 1000;
+    uint32_t session = client->createSession(appId, "TTSBench", new BenchSessionCallback);
+    client->acquireResource(appId);
+    client->requestExtendedEvents(session, EXT_EVENT_ALL);
+    sleep(1);
+
+    Bench bench(td.options, *td.endpoint, client, session);
+    std::stringstream report;
+    auto start = Clock::now();
+
+    report << "{\n  \"endpoint\": {\"latencyMs\": " << td.options.latencyMs << ", \"bandwidth\": " << td.options.bandwidth
+        << ", \"errorRate\": " << td.options.errorRate << ", \"warmCache\": " << td.options.warmCache << "},\n";
+
+    std::stringstream workloads(td.options.workloads);
+    std::string workload;
+    while(std::getline(workloads, workload, ',')) {
+        TTSLOG_WARNING("Running workload \"%s\"", workload.c_str());
+        if(workload == "sequential")
+            report << "  \"sequential\": " << bench.sequential() << ",\n";
+        else if(workload == "queue")
+            report << "  \"queue\": " << bench.queue(false) << ",\n";
+        else if(workload == "batch")
+            report << "  \"batch\": " << bench.queue(true) << ",\n";
+        else if(workload == "cancel")
+            report << "  \"cancel\": " << bench.cancel() << ",\n";
+        else
+            TTSLOG_ERROR("Unknown workload \"%s\"", workload.c_str());
+    }
+
+    double elapsed = msSince(start, Clock::now()) / 1000;
+    report << "  \"throughput\": {\"seconds\": " << elapsed << ", \"completedSpeeches\": " << bench.completed()
+        << ", \"speechesPerSecond\": " << (elapsed > 0 ? bench.completed() / elapsed : 0)
+        << ", \"endpointRequests\": " << td.endpoint->requests() << ", \"endpointErrors\": " << td.endpoint->errors()
+        << ", \"endpointBytes\": " << td.endpoint->bytes() << "}\n}\n";
+
+    if(td.options.output == "-") {
+        std::cout << report.str();
+    } else {
+        std::ofstream out(td.options.output);
+        out << report.str();
+    }
+
+    client->destroySession(session);
+    delete client;
+    td.result = 0;
+    g_main_loop_quit(g_loop);
+}
+
+static pid_t launchEngine(const std::string &path) {
+    pid_t pid = fork();
+    if(pid == 0) {
+        execl(path.c_str(), path.c_str(), (char*)NULL);
+        _exit(127);
+    }
+    sleep(1); // Let TTSEngine register its rtRemote object
+    return pid;
+}
+
+int main(int argc, char *argv[]) {
+    ThreadData td;
+
+    if(argc > 1 && strcmp(argv[1], "--help") == 0) {
+        printf(\
+        " \n\
+        Usage : \n\
+        * %s [--engine <TTSEngine path>] [--port <n>] [--latency <ms>] [--bandwidth <bytes/s>] [--errors <percent>]\n\
+        *    [--canned <file with text<TAB>audio file lines>] [--count <n>] [--workloads sequential,queue,batch,cancel]\n\
+        *    [--warmCache] [--output <file>]\n\
+        \n", argv[0]);
+
+        return 0;
+    }
+
+    static struct option long_options[] =
+    {
+        {"engine",          required_argument, 0, 'e'},
+        {"port",            required_argument, 0, 'p'},
+        {"latency",         required_argument, 0, 'l'},
+        {"bandwidth",       required_argument, 0, 'b'},
+        {"errors",          required_argument, 0, 'r'},
+        {"canned",          required_argument, 0, 'c'},
+        {"count",           required_argument, 0, 'n'},
+        {"workloads",       required_argument, 0, 'w'},
+        {"output",          required_argument, 0, 'o'},
+
+        {"warmCache",       no_argument, &td.options.warmCache, 1},
+
+        {0, 0, 0, 0}
+    };
+
+    while (1)
+    {
+        int option_index = 0;
+        int c = getopt_long (argc, argv, "e:p:l:b:r:c:n:w:o:", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 0: break;
+            case 'e': td.options.engine = optarg; break;
+            case 'p': td.options.port = atoi(optarg); break;
+            case 'l': td.options.latencyMs = atoi(optarg); break;
+            case 'b': td.options.bandwidth = atoi(optarg); break;
+            case 'r': td.options.errorRate = atoi(optarg); break;
+            case 'c': td.options.canned = optarg; break;
+            case 'n': td.options.count = std::max(1, atoi(optarg)); break;
+            case 'w': td.options.workloads = optarg; break;
+            case 'o': td.options.output = optarg; break;
+            default: return 1;
+        }
+    }
+
+    StandInEndpoint endpoint(td.options);
+    if(!endpoint.start())
+        return 1;
+    td.endpoint = &endpoint;
+
+    pid_t engine = td.options.engine.empty() ? 0 : launchEngine(td.options.engine);
+
+    g_loop = g_main_loop_new(g_main_context_default(), FALSE);
+    std::thread thread(ThreadFunc, &td);
+    g_main_loop_run(g_loop);
+    thread.join();
+
+    endpoint.stop();
+    if(engine > 0) {
+        kill(engine, SIGTERM);
+        waitpid(engine, NULL, 0);
+    }
+
+    return td.result;
+}
@@ -0,0 +1,197 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+// Microbenchmark of the text normalization, sanitization & URL encoding of TTSSpeaker against the
+// earlier multi pass implementation (replace / erase passes + curl_easy_escape).
+
+#include "TTSTextSanitizer.h"
+
+#include <curl/curl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace TTS;
+
+// --- //
+
+// Earlier implementation
+namespace Legacy {
+
+void replaceIfIsolated(std::string& text, const std::string& search, const std::string& replace) {
+    size_t pos = 0;
+    while ((pos = text.find(search, pos)) != std::string::npos) {
+        bool punctBefore = (pos == 0 || std::ispunct(text[pos-1]) || std::isspace(text[pos-1]));
+        bool punctAfter = (pos+1 == text.length() || std::ispunct(text[pos+1]) || std::isspace(text[pos+1]));
+
+        if(punctBefore && punctAfter) {
+            text.replace(pos, search.length(), replace);
+            pos += replace.length();
+        } else {
+            pos += search.length();
+        }
+    }
+}
+
+bool isSilentPunctuation(const char c) {
+    static std::string SilentPunctuation = "?!:;-()";
+    return (SilentPunctuation.find(c) != std::string::npos);
+}
+
+void replaceSuccesivePunctuation(std::string& text) {
+    size_t pos = 0;
+    while(pos < text.length()) {
+        // Remove unwanted characters
+        static std::string stray = "\"";
+        if(stray.find(text[pos]) != std::string::npos) {
+            text.erase(pos,1);
+            if(++pos == text.length())
+                break;
+        }
+
+        if(ispunct(text[pos])) {
+            ++pos;
+            while(pos < text.length() && (isSilentPunctuation(text[pos]) || isspace(text[pos]))) {
+                if(isSilentPunctuation(text[pos]))
+                    text.erase(pos,1);
+                else
+                    ++pos;
+            }
+        } else {
+            ++pos;
+        }
+    }
+}
+
+void curlSanitize(std::string &sanitizedString) {
+    CURL *curl = curl_easy_init();
+    if(curl) {
+      char *output = curl_easy_escape(curl, sanitizedString.c_str(), sanitizedString.size());
+      if(output) {
+          sanitizedString = output;
+          curl_free(output);
+      }
+    }
+    curl_easy_cleanup(curl);
+}
+
+void process(const std::string &input, std::string &url) {
+    std::string sanitizedString = input;
+    replaceIfIsolated(sanitizedString, "$", "dollar");
+    replaceIfIsolated(sanitizedString, "#", "pound");
+    replaceIfIsolated(sanitizedString, "&", "and");
+    replaceIfIsolated(sanitizedString, "|", "bar");
+    replaceIfIsolated(sanitizedString, "/", "or");
+    replaceSuccesivePunctuation(sanitizedString);
+    curlSanitize(sanitizedString);
+    url = sanitizedString;
+}
+
+} // namespace Legacy
+
+void process(const TTSNormalizer &normalizer, const std::string &input, std::string &normalized, std::string &sanitized, std::string &url) {
+    normalizer.normalize(input.data(), input.size(), normalized);
+    sanitizeText(normalized.data(), normalized.size(), sanitized);
+    url.clear();
+    appendPercentEncoded(sanitized.data(), sanitized.size(), url);
+}
+
+// --- //
+
+static const char *g_words[] = {
+    "the", "detective", "returns", "to", "city", "after", "years", "of", "silence", "when",
+    "a", "string", "of", "burglaries", "$", "5", "&", "Co.", "#1", "hit", "S01E04", "/",
+    "HD", "|", "CC", "--", "(2019)", "TV-14", "...", "!!", "?!", ":", "-", "café", "US$",
+    "and/or", "AT&T", "news;", "live:", "(repeat)", "-", "'n'",
+};
+
+// EPG like descriptions of the given length, with dense punctuation
+static std::string description(size_t length, unsigned int seed) {
+    std::string text;
+    srand(seed);
+    while(text.length() < length) {
+        text += g_words[rand() % (sizeof(g_words) / sizeof(g_words[0]))];
+        switch(rand() % 6) {
+            case 0: text += ", "; break;
+            case 1: text += ". "; break;
+            default: text += " "; break;
+        }
+    }
+    return text;
+}
+
+template<typename F> static double nsPerCall(int iterations, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i)
+        f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 2000;
+    std::vector<size_t> lengths = { 64, 512, 2048, 8192 };
+
+    int c;
+    while((c = getopt(argc, argv, "n:l:h")) != -1) {
+        switch(c) {
+            case 'n': iterations = std::max(1, atoi(optarg)); break;
+            case 'l': lengths = { (size_t)std::max(1, atoi(optarg)) }; break;
+            default:
+                printf("Usage : %s [-n <iterations>] [-l <text length>]\n", argv[0]);
+                return 0;
+        }
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    TTSNormalizer normalizer;
+    normalizer.addDefaultRules();
+    normalizer.compile();
+
+    printf("%10s %14s %14s %10s %10s\n", "length", "legacy ns", "single ns", "speedup", "mismatch");
+    for(size_t length : lengths) {
+        std::vector<std::string> texts;
+        for(unsigned int i = 0; i < 16; ++i)
+            texts.push_back(description(length, i + 1));
+
+        int mismatches = 0;
+        std::string legacyUrl, normalized, sanitized, url;
+        for(auto &text : texts) {
+            Legacy::process(text, legacyUrl);
+            process(normalizer, text, normalized, sanitized, url);
+            mismatches += (legacyUrl != url);
+        }
+
+        size_t next = 0;
+        double legacy = nsPerCall(iterations, [&] { Legacy::process(texts[next++ % texts.size()], legacyUrl); });
+        next = 0;
+        double single = nsPerCall(iterations, [&] { process(normalizer, texts[next++ % texts.size()], normalized, sanitized, url); });
+
+        printf("%10zu %14.0f %14.0f %9.1fx %10d\n", length, legacy, single, legacy / single, mismatches);
+    }
+
+    curl_global_cleanup();
+    return 0;
+}
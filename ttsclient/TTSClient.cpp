@@ -19,6 +19,7 @@
 
 #include "TTSClientPrivateJsonRPC.h"
 #include "TTSClientPrivateRtRemote.h"
+#include "TTSClientRequestQueue.h"
 #include "logger.h"
 #include <mutex>
 
@@ -56,9 +57,16 @@ TTSClient::TTSClient(TTSConnectionCallback *callback, bool discardRtDispatching)
     } else {
         m_priv = new TTSClientPrivateRtRemote(callback, discardRtDispatching);
     }
+    m_requests = new TTSClientRequestQueue();
 }
 
 TTSClient::~TTSClient() {
+    // Completes the queued requests, which need m_priv
+    if(m_requests) {
+        delete m_requests;
+        m_requests = NULL;
+    }
+
     if(m_priv) {
         delete m_priv;
         m_priv = NULL;
@@ -130,6 +138,11 @@ TTS_Error TTSClient::setPreemptiveSpeak(uint32_t sessionid, bool preemptive) {
     return m_priv->setPreemptiveSpeak(sessionid, preemptive);
 }
 
+TTS_Error TTSClient::setPriority(uint32_t sessionid, uint8_t priority) {
+    CHECK_PRIV();
+    return m_priv->setPriority(sessionid, priority);
+}
+
 TTS_Error TTSClient::requestExtendedEvents(uint32_t sessionid, uint32_t extendedEvents) {
     CHECK_PRIV();
     return m_priv->requestExtendedEvents(sessionid, extendedEvents);
@@ -140,6 +153,11 @@ TTS_Error TTSClient::speak(uint32_t sessionid, SpeechData& data) {
     return m_priv->speak(sessionid, data);
 }
 
+TTS_Error TTSClient::speakBatch(uint32_t sessionid, std::vector<SpeechData>& speeches) {
+    CHECK_PRIV();
+    return m_priv->speakBatch(sessionid, speeches);
+}
+
 TTS_Error TTSClient::pause(uint32_t sessionid, uint32_t speechid) {
     CHECK_PRIV();
     return m_priv->pause(sessionid, speechid);
@@ -165,4 +183,62 @@ TTS_Error TTSClient::getSpeechState(uint32_t sessionid, uint32_t speechid, Speec
     return m_priv->getSpeechState(sessionid, speechid, state);
 }
 
+TTS_Error TTSClient::queueRequest(std::function<TTS_Error()> &&call, ResultCallback &callback) {
+    CHECK_PRIV();
+    bool queued = m_requests->add([this, call, callback] () {
+        TTS_Error error = call();
+        if(callback)
+            m_requests->deliver(m_priv->dispatcherContext(), [callback, error] () { callback(error); });
+    });
+
+    if(!queued) {
+        TTSLOG_ERROR("TTSClient is being destroyed, request is not queued");
+        return TTS_FAIL;
+    }
+    return TTS_OK;
+}
+
+TTS_Error TTSClient::speakAsync(uint32_t sessionid, const SpeechData& data, ResultCallback callback) {
+    SpeechData speech = data;
+    return queueRequest([this, sessionid, speech] () mutable { return m_priv->speak(sessionid, speech); }, callback);
+}
+
+TTS_Error TTSClient::speakBatchAsync(uint32_t sessionid, const std::vector<SpeechData>& speeches, ResultCallback callback) {
+    std::vector<SpeechData> batch = speeches;
+    return queueRequest([this, sessionid, batch] () mutable { return m_priv->speakBatch(sessionid, batch); }, callback);
+}
+
+TTS_Error TTSClient::pauseAsync(uint32_t sessionid, uint32_t speechid, ResultCallback callback) {
+    return queueRequest([this, sessionid, speechid] () { return m_priv->pause(sessionid, speechid); }, callback);
+}
+
+TTS_Error TTSClient::resumeAsync(uint32_t sessionid, uint32_t speechid, ResultCallback callback) {
+    return queueRequest([this, sessionid, speechid] () { return m_priv->resume(sessionid, speechid); }, callback);
+}
+
+TTS_Error TTSClient::abortAsync(uint32_t sessionid, bool clearPending, ResultCallback callback) {
+    return queueRequest([this, sessionid, clearPending] () { return m_priv->abort(sessionid, clearPending); }, callback);
+}
+
+TTS_Error TTSClient::isSpeakingAsync(uint32_t sessionid, SpeakingCallback callback) {
+    CHECK_PRIV();
+    bool queued = m_requests->add([this, sessionid, callback] () {
+        bool speaking = m_priv->isSpeaking(sessionid);
+        if(callback)
+            m_requests->deliver(m_priv->dispatcherContext(), [callback, speaking] () { callback(speaking); });
+    });
+    return queued ? TTS_OK : TTS_FAIL;
+}
+
+TTS_Error TTSClient::getSpeechStateAsync(uint32_t sessionid, uint32_t speechid, SpeechStateCallback callback) {
+    CHECK_PRIV();
+    bool queued = m_requests->add([this, sessionid, speechid, callback] () {
+        SpeechState state = SPEECH_NOT_FOUND;
+        TTS_Error error = m_priv->getSpeechState(sessionid, speechid, state);
+        if(callback)
+            m_requests->deliver(m_priv->dispatcherContext(), [callback, error, state] () { callback(error, state); });
+    });
+    return queued ? TTS_OK : TTS_FAIL;
+}
+
 } // namespace TTS
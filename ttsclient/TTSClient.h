@@ -23,6 +23,7 @@
 
 #include <iostream>
 #include <vector>
+#include <functional>
 
 namespace TTS {
 
@@ -80,6 +81,11 @@ public:
     virtual void onSpeechComplete(uint32_t appId, uint32_t sessionId, SpeechData &data) { (void)appId; (void)sessionId; (void)data; }
 };
 
+// Results of the asynchronous APIs
+typedef std::function<void(TTS_Error error)> ResultCallback;
+typedef std::function<void(bool speaking)> SpeakingCallback;
+typedef std::function<void(TTS_Error error, SpeechState state)> SpeechStateCallback;
+
 //
 // Note :
 // The Session APIs are designed to have multiple sessions for a client
@@ -87,6 +93,7 @@ public:
 // all the APIs, except createSession, will be omitted, the internaly maintained ID will be used.
 //
 class TTSClientPrivateInterface;
+class TTSClientRequestQueue;
 class TTSClient {
 public:
     static TTSClient *create(TTSConnectionCallback *connCallback, bool discardRtDispatching=false);
@@ -110,21 +117,40 @@ public:
     TTS_Error destroySession(uint32_t sessionid);
     bool isActiveSession(uint32_t sessionid, bool forcefetch=false);
     TTS_Error setPreemptiveSpeak(uint32_t sessionid, bool preemptive);
+    // Priority (0 - TTS_MAX_PRIORITY) of the session's speeches, effective under Priority policy
+    TTS_Error setPriority(uint32_t sessionid, uint8_t priority);
     TTS_Error requestExtendedEvents(uint32_t sessionid, uint32_t extendedEvents);
 
     // Speak APIs
     TTS_Error speak(uint32_t sessionid, SpeechData& data);
+    // Queues all the speeches in a single request, the events are sent per speech as with speak()
+    TTS_Error speakBatch(uint32_t sessionid, std::vector<SpeechData>& speeches);
     TTS_Error pause(uint32_t sessionid, uint32_t speechid);
     TTS_Error resume(uint32_t sessionid, uint32_t speechid);
     TTS_Error abort(uint32_t sessionid, bool clearPending = false);
     bool isSpeaking(uint32_t sessionid);
     TTS_Error getSpeechState(uint32_t sessionid, uint32_t speechid, SpeechState &state);
 
+    // Asynchronous Speak APIs
+    // These return right away (TTS_FAIL if the request couldn't be queued), the requests are sent
+    // in the order they were made & the results are delivered on the client's dispatcher thread
+    // (TTSClient's rtRemote dispatcher, or else the main loop of the thread which created the TTSClient).
+    TTS_Error speakAsync(uint32_t sessionid, const SpeechData& data, ResultCallback callback = nullptr);
+    TTS_Error speakBatchAsync(uint32_t sessionid, const std::vector<SpeechData>& speeches, ResultCallback callback = nullptr);
+    TTS_Error pauseAsync(uint32_t sessionid, uint32_t speechid, ResultCallback callback = nullptr);
+    TTS_Error resumeAsync(uint32_t sessionid, uint32_t speechid, ResultCallback callback = nullptr);
+    TTS_Error abortAsync(uint32_t sessionid, bool clearPending = false, ResultCallback callback = nullptr);
+    TTS_Error isSpeakingAsync(uint32_t sessionid, SpeakingCallback callback);
+    TTS_Error getSpeechStateAsync(uint32_t sessionid, uint32_t speechid, SpeechStateCallback callback);
+
 private:
     TTSClient(TTSConnectionCallback *client, bool discardRtDispatching=false);
     TTSClient(TTSClient&) = delete;
 
     TTSClientPrivateInterface *m_priv;
+    TTSClientRequestQueue *m_requests;
+
+    TTS_Error queueRequest(std::function<TTS_Error()> &&call, ResultCallback &callback);
 };
 
 } // namespace TTS
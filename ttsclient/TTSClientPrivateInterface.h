@@ -19,6 +19,8 @@
 #ifndef _TTS_CLIENT_PRIVATE_INTERFACE_H_
 #define _TTS_CLIENT_PRIVATE_INTERFACE_H_
 
+#include <glib.h>
+
 namespace TTS {
 
 bool isProgramRunning(const char* name);
@@ -45,15 +47,20 @@ public:
     virtual TTS_Error destroySession(uint32_t sessionId) = 0;
     virtual bool isActiveSession(uint32_t sessionId, bool forcefetch=false) = 0;
     virtual TTS_Error setPreemptiveSpeak(uint32_t sessionId, bool preemptive=true) = 0;
+    virtual TTS_Error setPriority(uint32_t sessionId, uint8_t priority) = 0;
     virtual TTS_Error requestExtendedEvents(uint32_t sessionId, uint32_t extendedEvents) = 0;
 
     // Speak APIs
     virtual TTS_Error speak(uint32_t sessionId, SpeechData& data) = 0;
+    virtual TTS_Error speakBatch(uint32_t sessionId, std::vector<SpeechData>& speeches) = 0;
     virtual TTS_Error pause(uint32_t sessionId, uint32_t speechId = 0) = 0;
     virtual TTS_Error resume(uint32_t sessionId, uint32_t speechId = 0) = 0;
     virtual TTS_Error abort(uint32_t sessionId, bool clearPending) = 0;
     virtual bool isSpeaking(uint32_t sessionId) = 0;
     virtual TTS_Error getSpeechState(uint32_t sessionId, uint32_t speechId, SpeechState &state) = 0;
+
+    // Context of the thread dispatching the events, NULL when it is up to the app
+    virtual GMainContext *dispatcherContext() { return NULL; }
 };
 
 } // namespace TTS
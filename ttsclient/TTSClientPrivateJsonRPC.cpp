@@ -211,6 +211,17 @@ TTS_Error TTSClientPrivateJsonRPC::speak(uint32_t sessionId, SpeechData& data) {
     return TTS_OK;
 }
 
+// TextToSpeech service has no batch request, the speeches are sent one by one
+TTS_Error TTSClientPrivateJsonRPC::speakBatch(uint32_t sessionId, std::vector<SpeechData>& speeches) {
+    for(auto &data : speeches) {
+        TTS_Error error = speak(sessionId, data);
+        if(error != TTS_OK)
+            return error;
+    }
+
+    return TTS_OK;
+}
+
 TTS_Error TTSClientPrivateJsonRPC::abort(uint32_t sessionId, bool clearPending) {
     CHECK_CONNECTION_RETURN_ON_FAIL(TTS_FAIL);
     UNUSED(sessionId);
@@ -127,10 +127,12 @@ public:
     TTS_Error destroySession(uint32_t sessionId) override;
     bool isActiveSession(uint32_t, bool forcefetch=false) override { (void)forcefetch; return true; }
     TTS_Error setPreemptiveSpeak(uint32_t, bool preemptive=true) override { (void)preemptive; return TTS_OK; }
+    TTS_Error setPriority(uint32_t, uint8_t) override { return TTS_OK; }
     TTS_Error requestExtendedEvents(uint32_t, uint32_t) override { return TTS_OK; }
 
     // Speak APIs
     TTS_Error speak(uint32_t sessionId, SpeechData& data) override;
+    TTS_Error speakBatch(uint32_t sessionId, std::vector<SpeechData>& speeches) override;
     TTS_Error pause(uint32_t sessionId, uint32_t speechId = 0) override;
     TTS_Error resume(uint32_t sessionId, uint32_t speechId = 0) override;
     TTS_Error abort(uint32_t sessionId, bool clearPending) override;
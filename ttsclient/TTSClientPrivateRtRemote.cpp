@@ -22,6 +22,8 @@
 #include "logger.h"
 #include "glib_utils.h"
 #include "rt_msg_dispatcher.h"
+#include "TTSSpeechBatch.h"
+#include "TTSEventBatch.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -294,30 +296,24 @@ void TTSClientPrivateRtRemote::StartDispatcherThread() {
     m_dispatchThread = new std::thread([]() {
         TTSLOG_INFO("Starting Dispatch thread %ld", syscall(__NR_gettid));
 
-        int pipefd[2];
         GMainContext *context = g_main_context_new();
         g_main_context_push_thread_default(context);
         GMainLoop *loop = g_main_loop_new(context, FALSE);
         m_dispatcherMainLoop = loop;
 
-        if(pipe(pipefd) == -1) {
-            TTSLOG_ERROR("Can't create pipe, can't install rtRemoteQueueReadyHandler");
-            return;
-        }
-
         // Set GSource to call rtRemoteProcessSingleItem() on rt message arrival
-        GSource *source = installRtRemoteMessageHandler(pipefd, context);
+        GSource *source = installRtRemoteMessageHandler(context);
+        if(!source)
+            return;
 
         // Run main loop
         g_main_loop_run(loop);
 
         // Cleanup
         TTSLOG_INFO("Cleaning up dispatcher thread");
-        g_source_unref(source);
+        uninstallRtRemoteMessageHandler(source);
         g_main_loop_unref(loop);
         g_main_context_unref(context);
-        close(pipefd[0]);
-        close(pipefd[1]);
         TTSLOG_INFO("Dispatcher thread exit");
     });
 }
@@ -379,6 +375,13 @@ TTSClientPrivateRtRemote::~TTSClientPrivateRtRemote() {
     }
 }
 
+GMainContext *TTSClientPrivateRtRemote::dispatcherContext() {
+    GMainLoop *loop = m_dispatcherMainLoop;
+    if(m_discardDispatchThread || !loop)
+        return NULL;
+    return g_main_loop_get_context(loop);
+}
+
 void TTSClientPrivateRtRemote::cleanupConnection(bool serverCrash) {
     TTSLOG_WARNING("Cleaning up TTS Connection");
     bool tconnected = m_connected;
@@ -667,6 +670,10 @@ uint32_t TTSClientPrivateRtRemote::createSession(uint32_t appId, std::string app
 
             INSTALL_HANDLER_CHECK_RESULT(sessionInfo->m_session, "started", sessionInfo->m_rtEventCallback.ptr());
             INSTALL_HANDLER_CHECK_RESULT(sessionInfo->m_session, "spoke", sessionInfo->m_rtEventCallback.ptr());
+
+            // Get the events of the session in batches (TTSEngine ignores it, if it doesn't support)
+            if(!getenv("TTS_CLIENT_UNBATCHED_EVENTS"))
+                INSTALL_HANDLER_CHECK_RESULT(sessionInfo->m_session, TTS_EVENT_BATCH, sessionInfo->m_rtEventCallback.ptr());
         } else {
             sessionInfo->m_sessionId = 0;
             TTSLOG_ERROR("Session ID couldn't be retrieved");
@@ -743,6 +750,23 @@ TTS_Error TTSClientPrivateRtRemote::setPreemptiveSpeak(uint32_t sessionId, bool
     return TTS_OK;
 }
 
+TTS_Error TTSClientPrivateRtRemote::setPriority(uint32_t sessionId, uint8_t priority) {
+    SessionInfo *sessionInfo;
+    std::map<uint32_t, SessionInfo*>::iterator sessionItr;
+
+    CHECK_CONNECTION_RETURN_ON_FAIL(TTS_FAIL);
+    CHECK_SESSION_RETURN_ON_FAIL(sessionId, sessionItr, sessionInfo, TTS_NO_SESSION_FOUND);
+
+    rtValue result;
+    rtError rc = sessionInfo->m_session.sendReturns("setPriority", (uint32_t)priority, result);
+    if(rc != RT_OK || result.toUInt8() != TTS_OK) {
+        TTSLOG_ERROR("Coudn't set speech priority, TTS Code = %u", result.toUInt8());
+        return (TTS_Error)result.toUInt8();
+    }
+
+    return TTS_OK;
+}
+
 TTS_Error TTSClientPrivateRtRemote::requestExtendedEvents(uint32_t sessionId, uint32_t extendedEvents) {
     SessionInfo *sessionInfo;
     std::map<uint32_t, SessionInfo*>::iterator sessionItr;
@@ -796,6 +820,41 @@ TTS_Error TTSClientPrivateRtRemote::speak(uint32_t sessionId, SpeechData& data)
     return TTS_OK;
 }
 
+TTS_Error TTSClientPrivateRtRemote::speakBatch(uint32_t sessionId, std::vector<SpeechData>& speeches) {
+    SessionInfo *sessionInfo;
+    std::map<uint32_t, SessionInfo*>::iterator sessionItr;
+
+    CHECK_CONNECTION_RETURN_ON_FAIL(TTS_FAIL);
+    CHECK_SESSION_RETURN_ON_FAIL(sessionId, sessionItr, sessionInfo, TTS_NO_SESSION_FOUND);
+    UNUSED(sessionId);
+
+    if(!m_ttsEnabled) {
+        TTSLOG_ERROR("TTS is disabled, can't speak");
+        return TTS_NOT_ENABLED;
+    }
+
+    if(!sessionInfo->m_gotResource) {
+        TTSLOG_WARNING("Session is not active, can't speak");
+        return TTS_SESSION_NOT_ACTIVE;
+    }
+
+    if(speeches.empty())
+        return TTS_OK;
+
+    std::string batch;
+    for(auto &data : speeches)
+        appendSpeechRecord(batch, data.id, data.secure, data.text);
+
+    rtValue result;
+    rtError rc = sessionInfo->m_session.sendReturns("speakBatch", rtString(batch.data(), batch.size()), result);
+    if(rc != RT_OK || result.toUInt8() != TTS_OK) {
+        TTSLOG_ERROR("Coudn't speak the batch of %d speeches, TTS Code = %u", (int)speeches.size(), result.toUInt8());
+        return (TTS_Error)result.toUInt8();
+    }
+
+    return TTS_OK;
+}
+
 TTS_Error TTSClientPrivateRtRemote::abort(uint32_t sessionId, bool clearPending) {
     SessionInfo *sessionInfo;
     std::map<uint32_t, SessionInfo*>::iterator sessionItr;
@@ -926,7 +985,9 @@ rtError TTSClientPrivateRtRemote::onEventCB(int numArgs, const rtValue* args, rt
         }
 
         // Handle Client / Session Events
-        if(cbwrapper->isConnectionCBData())
+        if(args[0].getType() == RT_stringType)
+            rc = onEventBatch(args[0].toString(), cbwrapper);
+        else if(cbwrapper->isConnectionCBData())
             rc = onConnectionEvent(args[0].toObject(), (TTSClientPrivateRtRemote*)cbwrapper->data());
         else
             rc = onSessionEvent(args[0].toObject(), (SessionInfo*)cbwrapper->data());
@@ -938,6 +999,35 @@ rtError TTSClientPrivateRtRemote::onEventCB(int numArgs, const rtValue* args, rt
     return rc;
 }
 
+rtError TTSClientPrivateRtRemote::onEventBatch(const rtString &batch, CallbackDataWrapper *cbwrapper) {
+    bool valid = forEachEventRecord(batch.cString(), batch.byteLength(),
+        [cbwrapper] (const std::string &name, const std::vector<EventField> &fields) {
+            // The client / session may have been destroyed by the previous event's callback
+            if(!cbwrapper->data())
+                return;
+
+            // Local object, so that the event handlers don't reach TTSEngine for the fields
+            rtObjectRef event = new rtMapObject;
+            event.set("name", rtString(name.c_str()));
+            for(auto &field : fields) {
+                if(field.type == EVENT_FIELD_STRING)
+                    event.set(field.key.c_str(), rtString(field.value.data(), field.value.size()));
+                else
+                    event.set(field.key.c_str(), (uint32_t)strtoul(field.value.c_str(), NULL, 10));
+            }
+
+            if(cbwrapper->isConnectionCBData())
+                onConnectionEvent(event, (TTSClientPrivateRtRemote*)cbwrapper->data());
+            else
+                onSessionEvent(event, (SessionInfo*)cbwrapper->data());
+        });
+
+    if(!valid)
+        TTSLOG_ERROR("Malformed event batch, rest of the events are dropped");
+
+    return RT_OK;
+}
+
 rtError TTSClientPrivateRtRemote::onConnectionEvent(const rtObjectRef &event, TTSClientPrivateRtRemote *client) {
     rtValue val;
     if(event.get("name", val) == RT_OK) {
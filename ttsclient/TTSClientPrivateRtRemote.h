@@ -100,15 +100,18 @@ public:
     TTS_Error destroySession(uint32_t sessionId) override;
     bool isActiveSession(uint32_t sessionId, bool forcefetch=false) override;
     TTS_Error setPreemptiveSpeak(uint32_t sessionId, bool preemptive=true) override;
+    TTS_Error setPriority(uint32_t sessionId, uint8_t priority) override;
     TTS_Error requestExtendedEvents(uint32_t sessionId, uint32_t extendedEvents) override;
 
     // Speak APIs
     TTS_Error speak(uint32_t sessionId, SpeechData& data) override;
+    TTS_Error speakBatch(uint32_t sessionId, std::vector<SpeechData>& speeches) override;
     TTS_Error pause(uint32_t sessionId, uint32_t speechId = 0) override;
     TTS_Error resume(uint32_t sessionId, uint32_t speechId = 0) override;
     TTS_Error abort(uint32_t sessionId, bool clearPending) override;
     bool isSpeaking(uint32_t sessionId) override;
     TTS_Error getSpeechState(uint32_t sessionId, uint32_t speechId, SpeechState &state) override;
+    GMainContext *dispatcherContext() override;
 
 private:
     TTSClientPrivateRtRemote(TTSClientPrivateRtRemote&) = delete;
@@ -140,6 +143,7 @@ private:
     static void rtServerCrashCB(void *data);
     static void StartDispatcherThread();
     static rtError onEventCB(int numArgs, const rtValue* args, rtValue* result, void* context);
+    static rtError onEventBatch(const rtString &batch, CallbackDataWrapper *cbwrapper);
     static rtError onConnectionEvent(const rtObjectRef &event, TTSClientPrivateRtRemote *client);
     static rtError onSessionEvent(const rtObjectRef &event, SessionInfo *sessionInfo);
 
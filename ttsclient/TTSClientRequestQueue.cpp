@@ -0,0 +1,99 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include "TTSClientRequestQueue.h"
+#include "logger.h"
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace TTS {
+
+TTSClientRequestQueue::TTSClientRequestQueue() :
+    m_thread(NULL),
+    m_runThread(true),
+    m_ownerContext(g_main_context_ref_thread_default()) {
+}
+
+TTSClientRequestQueue::~TTSClientRequestQueue() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_runThread = false;
+        m_condition.notify_one();
+    }
+
+    // Let the requests made so far complete, the results reach the main context later
+    if(m_thread) {
+        m_thread->join();
+        delete m_thread;
+        m_thread = NULL;
+    }
+
+    g_main_context_unref(m_ownerContext);
+}
+
+bool TTSClientRequestQueue::add(Request &&request) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_runThread)
+        return false;
+
+    if(!m_thread)
+        m_thread = new std::thread(RequestThreadFunc, this);
+
+    m_requests.push_back(std::move(request));
+    m_condition.notify_one();
+    return true;
+}
+
+void TTSClientRequestQueue::deliver(GMainContext *context, Request &&result) {
+    g_main_context_invoke_full(context ? context : m_ownerContext, G_PRIORITY_DEFAULT,
+        RunResult, new Request(std::move(result)), DestroyResult);
+}
+
+gboolean TTSClientRequestQueue::RunResult(gpointer data) {
+    (*(Request*)data)();
+    return G_SOURCE_REMOVE;
+}
+
+void TTSClientRequestQueue::DestroyResult(gpointer data) {
+    delete (Request*)data;
+}
+
+void TTSClientRequestQueue::RequestThreadFunc(void *ctx) {
+    TTSClientRequestQueue *self = (TTSClientRequestQueue*)ctx;
+    TTSLOG_INFO("Starting Request thread %ld", syscall(__NR_gettid));
+
+    while(true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(self->m_mutex);
+            self->m_condition.wait(lock, [self] () { return !self->m_requests.empty() || !self->m_runThread; });
+            if(self->m_requests.empty())
+                break;
+
+            request = std::move(self->m_requests.front());
+            self->m_requests.pop_front();
+        }
+
+        request();
+    }
+
+    TTSLOG_INFO("Request thread exit");
+}
+
+} // namespace TTS
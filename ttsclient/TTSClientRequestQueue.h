@@ -0,0 +1,70 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_CLIENT_REQUEST_QUEUE_H_
+#define _TTS_CLIENT_REQUEST_QUEUE_H_
+
+#include <glib.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace TTS {
+
+// Runs the requests of the asynchronous APIs on a worker thread, one after the other
+// in the order they were made, and delivers their results on the given main context.
+// The worker is started on the first request, so that the synchronous only clients
+// don't pay for it.
+class TTSClientRequestQueue {
+public:
+    typedef std::function<void()> Request;
+
+    TTSClientRequestQueue();
+    ~TTSClientRequestQueue();
+
+    // "request" is run on the worker thread, it may post its result with deliver()
+    // Returns false when the queue is being destroyed
+    bool add(Request &&request);
+
+    // Runs "result" on "context" (the calling thread's default context when NULL)
+    void deliver(GMainContext *context, Request &&result);
+
+    // Main context of the thread which created the queue, the fallback for deliver()
+    GMainContext *ownerContext() { return m_ownerContext; }
+
+private:
+    TTSClientRequestQueue(TTSClientRequestQueue&) = delete;
+
+    std::deque<Request> m_requests;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread *m_thread;
+    bool m_runThread;
+    GMainContext *m_ownerContext;
+
+    static void RequestThreadFunc(void *ctx);
+    static gboolean RunResult(gpointer data);
+    static void DestroyResult(gpointer data);
+};
+
+} // namespace TTS
+
+#endif //_TTS_CLIENT_REQUEST_QUEUE_H_
@@ -0,0 +1,222 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "TTSAudioCache.h"
+#include "logger.h"
+
+#include <chrono>
+
+namespace TTS {
+
+AudioClip::AudioClip(const std::string &key) :
+    m_key(key),
+    m_size(0),
+    m_complete(false),
+    m_failed(false),
+    m_cancelled(false) {
+}
+
+AudioClip::~AudioClip() {
+}
+
+void AudioClip::append(const char *data, size_t size) {
+    if(!data || !size)
+        return;
+
+    std::shared_ptr<std::string> buffer = std::make_shared<std::string>(data, size);
+
+    AudioChunk chunk;
+    chunk.data = buffer->data();
+    chunk.size = buffer->size();
+    chunk.owner = buffer;
+
+    append(chunk);
+}
+
+void AudioClip::append(const AudioChunk &chunk) {
+    if(!chunk.data || !chunk.size)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_chunks.push_back(chunk);
+    m_size += chunk.size;
+    m_condition.notify_all();
+}
+
+void AudioClip::complete(bool success) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_complete = true;
+    m_failed = !success;
+    m_condition.notify_all();
+}
+
+void AudioClip::cancel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cancelled = true;
+}
+
+bool AudioClip::isCancelled() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cancelled;
+}
+
+AudioClip::ReadStatus AudioClip::read(size_t index, AudioChunk &chunk, const std::function<bool()> &interrupted, uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> mlock(m_mutex);
+    bool ready = m_condition.wait_for(mlock, std::chrono::milliseconds(timeout_ms), [this, index, &interrupted] () {
+            return index < m_chunks.size() || m_complete || (interrupted && interrupted());
+        });
+
+    if(interrupted && interrupted())
+        return READ_INTERRUPTED;
+
+    if(index < m_chunks.size()) {
+        chunk = m_chunks[index];
+        return CHUNK_AVAILABLE;
+    }
+
+    if(m_complete)
+        return m_failed ? CLIP_FAILED : END_OF_CLIP;
+
+    return ready ? READ_INTERRUPTED : READ_TIMEDOUT;
+}
+
+void AudioClip::wakeup() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_condition.notify_all();
+}
+
+bool AudioClip::isComplete() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_complete;
+}
+
+bool AudioClip::isFailed() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+size_t AudioClip::size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+// --- //
+
+TTSAudioCache::TTSAudioCache(size_t maxBytes) :
+    m_maxBytes(maxBytes) {
+    m_stats.maxBytes = maxBytes;
+}
+
+TTSAudioCache::~TTSAudioCache() {
+    clear();
+}
+
+AudioClipPtr TTSAudioCache::acquire(const std::string &key, bool &created) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    created = false;
+
+    // Served from memory
+    auto it = m_index.find(key);
+    if(it != m_index.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        m_stats.hits++;
+        return *it->second;
+    }
+
+    // Someone is already fetching it, share the same clip
+    // (unless it was cancelled, its fetch is then given up & a fresh clip replaces it)
+    auto fit = m_inflight.find(key);
+    if(fit != m_inflight.end() && !fit->second->isCancelled()) {
+        m_stats.sharedFetches++;
+        return fit->second;
+    }
+
+    m_stats.misses++;
+    AudioClipPtr clip = std::make_shared<AudioClip>(key);
+    if(fit != m_inflight.end())
+        fit->second = clip;
+    else
+        m_inflight[key] = clip;
+    created = true;
+
+    return clip;
+}
+
+void TTSAudioCache::commit(const AudioClipPtr &clip) {
+    if(!clip)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto fit = m_inflight.find(clip->key());
+    if(fit != m_inflight.end() && fit->second == clip)
+        m_inflight.erase(fit);
+
+    size_t size = clip->size();
+    if(!clip->isComplete() || clip->isFailed() || size == 0 || size > m_maxBytes)
+        return;
+
+    auto it = m_index.find(clip->key());
+    if(it != m_index.end()) {
+        m_stats.bytes -= (*it->second)->size();
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_lru.push_front(clip);
+    m_index[clip->key()] = m_lru.begin();
+    m_stats.bytes += size;
+
+    evict(m_maxBytes);
+}
+
+void TTSAudioCache::setMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxBytes = maxBytes;
+    m_stats.maxBytes = maxBytes;
+    evict(m_maxBytes);
+}
+
+void TTSAudioCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_index.clear();
+    m_lru.clear();
+    m_inflight.clear();
+    m_stats.bytes = 0;
+}
+
+TTSAudioCache::Statistics TTSAudioCache::statistics() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Statistics stats = m_stats;
+    stats.entries = m_index.size();
+    return stats;
+}
+
+void TTSAudioCache::evict(size_t maxBytes) {
+    while(m_stats.bytes > maxBytes && !m_lru.empty()) {
+        AudioClipPtr &clip = m_lru.back();
+        TTSLOG_VERBOSE("Evicting clip of %zu bytes, key=%s", clip->size(), clip->key().c_str());
+        m_stats.bytes -= clip->size();
+        m_stats.evictions++;
+        m_index.erase(clip->key());
+        m_lru.pop_back();
+    }
+}
+
+} // namespace TTS
@@ -0,0 +1,141 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_AUDIO_CACHE_H_
+#define _TTS_AUDIO_CACHE_H_
+
+#include <stdint.h>
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+namespace TTS {
+
+// A piece of audio data, the owner keeps the memory behind "data" alive
+// as long as any copy of the chunk exists (i.e while GStreamer holds it)
+struct AudioChunk {
+    AudioChunk() : data(NULL), size(0) {}
+
+    const char *data;
+    size_t size;
+    std::shared_ptr<const void> owner;
+};
+
+// Audio of one synthesized text. A clip is filled by the fetcher and read
+// by the speaker at the same time, so appended chunks are never moved.
+class AudioClip {
+public:
+    enum ReadStatus {
+        CHUNK_AVAILABLE,
+        END_OF_CLIP,
+        CLIP_FAILED,
+        READ_INTERRUPTED,
+        READ_TIMEDOUT
+    };
+
+    AudioClip(const std::string &key);
+    ~AudioClip();
+
+    const std::string &key() const { return m_key; }
+
+    // Writer side
+    void append(const char *data, size_t size);
+    void append(const AudioChunk &chunk);
+    void complete(bool success);
+
+    // Asks the writer to give up, used when nobody needs the clip anymore
+    void cancel();
+    bool isCancelled();
+
+    // Reader side, waits for chunk #index. "interrupted" is evaluated under
+    // the clip lock, call wakeup() after changing the state it depends on
+    ReadStatus read(size_t index, AudioChunk &chunk, const std::function<bool()> &interrupted, uint32_t timeout_ms);
+    void wakeup();
+
+    bool isComplete();
+    bool isFailed();
+    size_t size();
+
+private:
+    std::string m_key;
+    std::vector<AudioChunk> m_chunks;
+    size_t m_size;
+    bool m_complete;
+    bool m_failed;
+    bool m_cancelled;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
+
+using AudioClipPtr = std::shared_ptr<AudioClip>;
+
+// Byte budgeted LRU cache of synthesized audio, keyed by the request
+// (endpoint, voice, language, rate & sanitized text). Clips which are still
+// being fetched are tracked separately, so that concurrent misses for the same
+// key share a single fetch.
+class TTSAudioCache {
+public:
+    struct Statistics {
+        Statistics() : hits(0), misses(0), sharedFetches(0), evictions(0), entries(0), bytes(0), maxBytes(0) {}
+
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t sharedFetches;
+        uint64_t evictions;
+        uint32_t entries;
+        uint64_t bytes;
+        uint64_t maxBytes;
+    };
+
+    TTSAudioCache(size_t maxBytes);
+    ~TTSAudioCache();
+
+    // Returns the cached / in-flight (not cancelled) clip for the key, otherwise a new empty clip
+    // with "created" set, the caller is then responsible for having it fetched
+    AudioClipPtr acquire(const std::string &key, bool &created);
+
+    // Moves a fetched clip from in-flight to the LRU (failed clips are dropped)
+    void commit(const AudioClipPtr &clip);
+
+    void setMaxBytes(size_t maxBytes);
+    void clear();
+    Statistics statistics();
+
+private:
+    using LRUList = std::list<AudioClipPtr>;
+
+    LRUList m_lru; // Most recently used at the front
+    std::unordered_map<std::string, LRUList::iterator> m_index;
+    std::unordered_map<std::string, AudioClipPtr> m_inflight;
+    size_t m_maxBytes;
+    Statistics m_stats;
+    std::mutex m_mutex;
+
+    void evict(size_t maxBytes);
+};
+
+} // namespace TTS
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "TTSAudioFetcher.h"
+#include "logger.h"
+
+#define FETCH_CONNECT_TIMEOUT_SECS 10
+#define FETCH_LOW_SPEED_TIME_SECS 10
+#define FETCH_KEEPALIVE_IDLE_SECS 30
+#define FETCH_KEEPALIVE_INTERVAL_SECS 15
+
+namespace TTS {
+
+TTSAudioFetcher::TTSAudioFetcher(TTSAudioCache &cache, TTSClipStore *store, uint32_t workers) :
+    m_cache(cache),
+    m_store(store),
+    m_runThread(true),
+    m_share(curl_share_init()) {
+    if(workers == 0)
+        workers = 1;
+
+    if(m_share) {
+        curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, ShareLock);
+        curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, ShareUnlock);
+        curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    }
+
+    for(uint32_t i = 0; i < workers; ++i)
+        m_workers.push_back(new std::thread(WorkerThreadFunc, this));
+}
+
+TTSAudioFetcher::~TTSAudioFetcher() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_runThread = false;
+        m_condition.notify_all();
+    }
+
+    for(auto it = m_workers.begin(); it != m_workers.end(); ++it) {
+        (*it)->join();
+        delete *it;
+    }
+    m_workers.clear();
+
+    if(m_share)
+        curl_share_cleanup(m_share);
+    m_share = NULL;
+
+    // Unblock the readers of the clips which were never fetched
+    for(auto it = m_jobs.begin(); it != m_jobs.end(); ++it) {
+        (*it)->complete(false);
+        m_cache.commit(*it);
+    }
+    m_jobs.clear();
+}
+
+void TTSAudioFetcher::fetch(const AudioClipPtr &clip) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(clip);
+    m_condition.notify_one();
+}
+
+size_t TTSAudioFetcher::WriteCallback(char *data, size_t size, size_t nmemb, void *ctx) {
+    AudioClip *clip = (AudioClip*)ctx;
+    clip->append(data, size * nmemb);
+    return size * nmemb;
+}
+
+void TTSAudioFetcher::ShareLock(CURL *, curl_lock_data data, curl_lock_access, void *ctx) {
+    TTSAudioFetcher *fetcher = (TTSAudioFetcher*)ctx;
+    fetcher->m_shareMutex[data].lock();
+}
+
+void TTSAudioFetcher::ShareUnlock(CURL *, curl_lock_data data, void *ctx) {
+    TTSAudioFetcher *fetcher = (TTSAudioFetcher*)ctx;
+    fetcher->m_shareMutex[data].unlock();
+}
+
+int TTSAudioFetcher::ProgressCallback(void *ctx, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    AudioClip *clip = (AudioClip*)ctx;
+    return clip->isCancelled() ? 1 : 0;
+}
+
+void TTSAudioFetcher::download(CURL *curl, const AudioClipPtr &clip) {
+    bool success = false;
+    if(clip->isCancelled()) {
+        TTSLOG_VERBOSE("Skipping cancelled fetch of %s", clip->key().c_str());
+        clip->complete(false);
+        m_cache.commit(clip);
+        return;
+    }
+
+    TTSLOG_VERBOSE("Fetching %s", clip->key().c_str());
+    if(curl) {
+        // Reset keeps the live connections & the session caches of the handle
+        curl_easy_reset(curl);
+        if(m_share)
+            curl_easy_setopt(curl, CURLOPT_SHARE, m_share);
+        curl_easy_setopt(curl, CURLOPT_URL, clip->key().c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, clip.get());
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)FETCH_CONNECT_TIMEOUT_SECS);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)FETCH_LOW_SPEED_TIME_SECS);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, clip.get());
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, (long)FETCH_KEEPALIVE_IDLE_SECS);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, (long)FETCH_KEEPALIVE_INTERVAL_SECS);
+
+        CURLcode rc = curl_easy_perform(curl);
+        long status = 0;
+        long connects = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+        TTSLOG_VERBOSE("Fetch done, status=%ld, %s connection", status, connects ? "new" : "reused");
+
+        if(rc == CURLE_ABORTED_BY_CALLBACK)
+            TTSLOG_VERBOSE("Fetch of %s is cancelled", clip->key().c_str());
+        else if(rc != CURLE_OK)
+            TTSLOG_ERROR("Fetching audio failed, %s", curl_easy_strerror(rc));
+        else if(status >= 400)
+            TTSLOG_ERROR("Fetching audio failed, HTTP status %ld", status);
+        else
+            success = true;
+    }
+
+    clip->complete(success);
+    m_cache.commit(clip);
+
+    if(m_store) {
+        if(success)
+            m_store->insert(clip);
+
+        // Files of the dropped records are removed here, off the main loop
+        m_store->sweep();
+    }
+}
+
+void TTSAudioFetcher::WorkerThreadFunc(void *ctx) {
+    TTSAudioFetcher *fetcher = (TTSAudioFetcher*)ctx;
+
+    TTSLOG_INFO("Starting AudioFetcherThread");
+
+    // Each worker keeps its handle (and so the connection) across the fetches
+    CURL *curl = curl_easy_init();
+    if(!curl)
+        TTSLOG_ERROR("Couldn't create curl handle");
+
+    while(fetcher && fetcher->m_runThread) {
+        AudioClipPtr clip;
+        {
+            std::unique_lock<std::mutex> mlock(fetcher->m_mutex);
+            fetcher->m_condition.wait(mlock, [fetcher] () {
+                    return !fetcher->m_jobs.empty() || !fetcher->m_runThread;
+                });
+
+            if(!fetcher->m_runThread)
+                break;
+
+            clip = fetcher->m_jobs.front();
+            fetcher->m_jobs.pop_front();
+        }
+
+        fetcher->download(curl, clip);
+    }
+
+    if(curl)
+        curl_easy_cleanup(curl);
+    TTSLOG_INFO("Stopping AudioFetcherThread");
+}
+
+} // namespace TTS
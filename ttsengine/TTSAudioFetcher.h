@@ -0,0 +1,68 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_AUDIO_FETCHER_H_
+#define _TTS_AUDIO_FETCHER_H_
+
+#include "TTSAudioCache.h"
+#include "TTSClipStore.h"
+
+#include <curl/curl.h>
+
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace TTS {
+
+// Downloads the audio of the requested clips (clip key is the request URL)
+// from the TTS endpoint on worker threads and hands them over to the cache
+// (and to the clip store, when one is given). Connections, TLS sessions & DNS
+// results are shared by the workers & kept alive for the lifetime of the fetcher.
+class TTSAudioFetcher {
+public:
+    TTSAudioFetcher(TTSAudioCache &cache, TTSClipStore *store=NULL, uint32_t workers=1);
+    ~TTSAudioFetcher();
+
+    void fetch(const AudioClipPtr &clip);
+
+private:
+    TTSAudioCache &m_cache;
+    TTSClipStore *m_store;
+    std::list<AudioClipPtr> m_jobs;
+    std::vector<std::thread*> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_runThread;
+
+    CURLSH *m_share;
+    std::mutex m_shareMutex[CURL_LOCK_DATA_LAST];
+
+    void download(CURL *curl, const AudioClipPtr &clip);
+    static size_t WriteCallback(char *data, size_t size, size_t nmemb, void *ctx);
+    static int ProgressCallback(void *ctx, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+    static void ShareLock(CURL *handle, curl_lock_data data, curl_lock_access access, void *ctx);
+    static void ShareUnlock(CURL *handle, curl_lock_data data, void *ctx);
+    static void WorkerThreadFunc(void *ctx);
+};
+
+} // namespace TTS
+
+#endif
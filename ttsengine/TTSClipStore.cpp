@@ -0,0 +1,467 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "TTSClipStore.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <thread>
+#include <algorithm>
+#include <vector>
+
+#define CLIP_STORE_MAGIC 0x54545343 // "TTSC"
+#define CLIP_STORE_FORMAT 1
+#define CLIP_FILE_MAGIC 0x54545341 // "TTSA"
+#define CLIP_FILE_EXTENSION ".clip"
+#define RECORD_VALID 0x1
+#define NO_SLOT UINT32_MAX
+#define CLIP_SWEEP_BATCH 64
+
+#define FNV_PRIME 1099511628211ULL
+
+namespace TTS {
+
+struct TTSClipStore::IndexHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t capacity;
+    uint32_t reserved;
+    uint64_t version;
+    uint64_t clock; // Bumped on every use, orders the records for LRU eviction
+};
+
+struct TTSClipStore::IndexRecord {
+    uint64_t keyHash;
+    uint64_t contentHash;
+    uint64_t lastUsed;
+    uint32_t size;
+    uint32_t flags;
+};
+
+// Header of the <content hash>.clip files, followed by the audio. Files are shared
+// by the keys which resulted in identical audio, so the key is not stored in them.
+struct ClipFileHeader {
+    uint32_t magic;
+    uint32_t audioSize;
+};
+
+TTSClipStore::TTSClipStore(const std::string &directory, size_t maxBytes, uint32_t maxEntries) :
+    m_directory(directory),
+    m_maxBytes(maxBytes),
+    m_maxEntries(maxEntries),
+    m_index(NULL),
+    m_records(NULL),
+    m_indexSize(0),
+    m_lruHead(NO_SLOT),
+    m_lruTail(NO_SLOT) {
+    m_stats.maxBytes = maxBytes;
+
+    if(m_directory.empty() || !m_maxBytes || !m_maxEntries) {
+        TTSLOG_INFO("Audio clip store is disabled");
+        return;
+    }
+
+    if(!openIndex())
+        closeIndex();
+}
+
+TTSClipStore::~TTSClipStore() {
+    closeIndex();
+}
+
+uint64_t TTSClipStore::hash(const char *data, size_t size, uint64_t seed) {
+    uint64_t h = seed;
+    for(size_t i = 0; i < size; ++i) {
+        h ^= (uint8_t)data[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+bool TTSClipStore::openIndex() {
+    if(mkdir(m_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        TTSLOG_ERROR("Couldn't create clip store directory \"%s\", %s", m_directory.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::string path = m_directory + "/index";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        TTSLOG_ERROR("Couldn't open clip store index \"%s\", %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    m_indexSize = sizeof(IndexHeader) + m_maxEntries * sizeof(IndexRecord);
+    bool reinitialize = (fstat(fd, &st) != 0 || (size_t)st.st_size != m_indexSize);
+    if(reinitialize && (ftruncate(fd, 0) != 0 || ftruncate(fd, m_indexSize) != 0)) {
+        TTSLOG_ERROR("Couldn't resize clip store index, %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    void *base = mmap(NULL, m_indexSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) {
+        TTSLOG_ERROR("Couldn't map clip store index, %s", strerror(errno));
+        return false;
+    }
+
+    m_index = (IndexHeader*)base;
+    m_records = (IndexRecord*)(m_index + 1);
+
+    if(m_index->magic != CLIP_STORE_MAGIC || m_index->format != CLIP_STORE_FORMAT || m_index->capacity != m_maxEntries) {
+        TTSLOG_WARNING("Initializing clip store index (%u entries)", m_maxEntries);
+        memset(base, 0, m_indexSize);
+        m_index->magic = CLIP_STORE_MAGIC;
+        m_index->format = CLIP_STORE_FORMAT;
+        m_index->capacity = m_maxEntries;
+    }
+
+    // Tables of the valid records, the least recently used ones are added first
+    m_lruPrev.assign(m_maxEntries, NO_SLOT);
+    m_lruNext.assign(m_maxEntries, NO_SLOT);
+    std::vector<uint32_t> valid;
+    for(uint32_t i = m_maxEntries; i-- > 0;) {
+        if(m_records[i].flags & RECORD_VALID)
+            valid.push_back(i);
+        else
+            m_freeSlots.push_back(i);
+    }
+    std::sort(valid.begin(), valid.end(), [this] (uint32_t a, uint32_t b) {
+            return m_records[a].lastUsed < m_records[b].lastUsed;
+        });
+    for(auto it = valid.begin(); it != valid.end(); ++it) {
+        if(m_slots.find(m_records[*it].keyHash) == m_slots.end()) {
+            addRecord(*it);
+        } else {
+            m_records[*it].flags = 0;
+            m_freeSlots.push_back(*it);
+        }
+    }
+
+    // Drop the records which don't fit the (possibly reduced) size cap anymore
+    while(m_stats.bytes > m_maxBytes && m_lruTail != NO_SLOT)
+        removeRecord(&m_records[m_lruTail]);
+
+    // Remove the clips which are not referred by the index (crash / power loss leftovers)
+    DIR *dir = opendir(m_directory.c_str());
+    if(dir) {
+        struct dirent *entry;
+        while((entry = readdir(dir)) != NULL) {
+            const char *ext = strrchr(entry->d_name, '.');
+            if(!ext || (strcmp(ext, CLIP_FILE_EXTENSION) != 0 && !strstr(entry->d_name, CLIP_FILE_EXTENSION ".tmp")))
+                continue;
+
+            bool referred = false;
+            if(strcmp(ext, CLIP_FILE_EXTENSION) == 0)
+                referred = (m_contentRefs.find(strtoull(entry->d_name, NULL, 16)) != m_contentRefs.end());
+
+            if(!referred)
+                unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+        closedir(dir);
+        m_unreferenced.clear();
+    }
+
+    TTSLOG_INFO("Opened clip store \"%s\", entries=%u, bytes=%" PRIu64, m_directory.c_str(), m_stats.entries, m_stats.bytes);
+    return true;
+}
+
+void TTSClipStore::closeIndex() {
+    if(m_index) {
+        msync(m_index, m_indexSize, MS_ASYNC);
+        munmap(m_index, m_indexSize);
+    }
+    m_index = NULL;
+    m_records = NULL;
+}
+
+std::string TTSClipStore::clipPath(uint64_t contentHash) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016" PRIx64 CLIP_FILE_EXTENSION, contentHash);
+    return m_directory + name;
+}
+
+TTSClipStore::IndexRecord *TTSClipStore::findRecord(uint64_t keyHash) {
+    auto it = m_slots.find(keyHash);
+    return (it != m_slots.end()) ? &m_records[it->second] : NULL;
+}
+
+TTSClipStore::IndexRecord *TTSClipStore::allocateRecord(size_t size) {
+    while(m_freeSlots.empty() || m_stats.bytes + size > m_maxBytes) {
+        if(m_lruTail == NO_SLOT)
+            return NULL;
+
+        removeRecord(&m_records[m_lruTail]);
+        m_stats.evictions++;
+    }
+
+    uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    return &m_records[slot];
+}
+
+void TTSClipStore::addRecord(uint32_t slot) {
+    IndexRecord &record = m_records[slot];
+    m_slots[record.keyHash] = slot;
+    m_contentRefs[record.contentHash]++;
+    lruPushFront(slot);
+    m_stats.entries++;
+    m_stats.bytes += record.size;
+}
+
+void TTSClipStore::removeRecord(IndexRecord *record) {
+    if(!record || !(record->flags & RECORD_VALID))
+        return;
+
+    uint32_t slot = record - m_records;
+    record->flags = 0;
+    m_slots.erase(record->keyHash);
+    lruUnlink(slot);
+    m_freeSlots.push_back(slot);
+    m_stats.entries--;
+    m_stats.bytes -= record->size;
+
+    // Identical audio of different keys share the same file
+    auto it = m_contentRefs.find(record->contentHash);
+    if(it != m_contentRefs.end() && --it->second == 0) {
+        m_contentRefs.erase(it);
+        m_unreferenced.push_back(record->contentHash);
+    }
+}
+
+void TTSClipStore::touchRecord(IndexRecord *record) {
+    uint32_t slot = record - m_records;
+    record->lastUsed = ++m_index->clock;
+    lruUnlink(slot);
+    lruPushFront(slot);
+}
+
+void TTSClipStore::lruUnlink(uint32_t slot) {
+    uint32_t prev = m_lruPrev[slot], next = m_lruNext[slot];
+    if(prev != NO_SLOT)
+        m_lruNext[prev] = next;
+    else if(m_lruHead == slot)
+        m_lruHead = next;
+    if(next != NO_SLOT)
+        m_lruPrev[next] = prev;
+    else if(m_lruTail == slot)
+        m_lruTail = prev;
+    m_lruPrev[slot] = m_lruNext[slot] = NO_SLOT;
+}
+
+void TTSClipStore::lruPushFront(uint32_t slot) {
+    m_lruPrev[slot] = NO_SLOT;
+    m_lruNext[slot] = m_lruHead;
+    if(m_lruHead != NO_SLOT)
+        m_lruPrev[m_lruHead] = slot;
+    else
+        m_lruTail = slot;
+    m_lruHead = slot;
+}
+
+void TTSClipStore::setVersion(uint64_t version) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_index || m_index->version == version)
+        return;
+
+    // Only the index is touched here (on the main loop), the files are left to sweep()
+    TTSLOG_WARNING("Clip store version changed (0x%" PRIx64 " -> 0x%" PRIx64 "), dropping %u clips",
+            m_index->version, version, m_stats.entries);
+    while(m_lruHead != NO_SLOT)
+        removeRecord(&m_records[m_lruHead]);
+    m_index->version = version;
+}
+
+void TTSClipStore::sweep() {
+    std::vector<uint64_t> batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while(!m_unreferenced.empty() && batch.size() < CLIP_SWEEP_BATCH) {
+            uint64_t contentHash = m_unreferenced.back();
+            m_unreferenced.pop_back();
+
+            // Identical audio may have been stored again meanwhile
+            if(m_contentRefs.find(contentHash) == m_contentRefs.end())
+                batch.push_back(contentHash);
+        }
+    }
+
+    // A clip re-stored while its file is being removed is found missing by lookup() & dropped
+    for(auto it = batch.begin(); it != batch.end(); ++it)
+        unlink(clipPath(*it).c_str());
+}
+
+bool TTSClipStore::lookup(const std::string &key, AudioChunk &chunk) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_index)
+        return false;
+
+    IndexRecord *record = findRecord(hash(key.data(), key.size(), m_index->version));
+    if(!record) {
+        m_stats.misses++;
+        return false;
+    }
+
+    std::string path = clipPath(record->contentHash);
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ClipFileHeader)) {
+        TTSLOG_WARNING("Clip \"%s\" is missing / invalid, removing it", path.c_str());
+        if(fd >= 0)
+            close(fd);
+        removeRecord(record);
+        m_stats.misses++;
+        return false;
+    }
+
+    size_t length = st.st_size;
+    void *base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) {
+        TTSLOG_ERROR("Couldn't map clip \"%s\", %s", path.c_str(), strerror(errno));
+        m_stats.misses++;
+        return false;
+    }
+
+    const ClipFileHeader *header = (const ClipFileHeader*)base;
+    if(header->magic != CLIP_FILE_MAGIC || header->audioSize != record->size ||
+        sizeof(ClipFileHeader) + header->audioSize != length) {
+        TTSLOG_WARNING("Clip \"%s\" is corrupted, removing it", path.c_str());
+        munmap(base, length);
+        removeRecord(record);
+        m_stats.misses++;
+        return false;
+    }
+
+    chunk.data = (const char*)(header + 1);
+    chunk.size = header->audioSize;
+    chunk.owner = std::shared_ptr<const void>(base, [length] (const void *p) { munmap((void*)p, length); });
+
+    touchRecord(record);
+    m_stats.hits++;
+    return true;
+}
+
+void TTSClipStore::insert(const AudioClipPtr &clip) {
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(!m_index)
+            return;
+        version = m_index->version;
+    }
+
+    size_t size = clip->size();
+    if(!clip->isComplete() || clip->isFailed() || size == 0 || size > m_maxBytes)
+        return;
+
+    // Collect the chunks, the clip is complete & can't change anymore
+    std::vector<AudioChunk> chunks;
+    uint64_t contentHash = hash(NULL, 0);
+    AudioChunk chunk;
+    while(clip->read(chunks.size(), chunk, nullptr, 0) == AudioClip::CHUNK_AVAILABLE) {
+        contentHash = hash(chunk.data, chunk.size, contentHash);
+        chunks.push_back(chunk);
+    }
+
+    // Write the clip outside the lock, playback shouldn't wait for the disk
+    const std::string &key = clip->key();
+    std::string path = clipPath(contentHash);
+    if(access(path.c_str(), F_OK) != 0) {
+        ClipFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = CLIP_FILE_MAGIC;
+        header.audioSize = size;
+
+        std::vector<struct iovec> iov;
+        iov.push_back({ &header, sizeof(header) });
+        for(auto it = chunks.begin(); it != chunks.end(); ++it)
+            iov.push_back({ (void*)it->data, it->size });
+
+        std::string tmpPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) {
+            TTSLOG_ERROR("Couldn't create clip \"%s\", %s", tmpPath.c_str(), strerror(errno));
+            return;
+        }
+
+        size_t expected = sizeof(header) + size;
+        size_t written = 0;
+        for(size_t i = 0; i < iov.size(); i += IOV_MAX) {
+            ssize_t ret = writev(fd, &iov[i], std::min<size_t>(IOV_MAX, iov.size() - i));
+            if(ret < 0)
+                break;
+            written += ret;
+        }
+        close(fd);
+
+        if(written != expected || rename(tmpPath.c_str(), path.c_str()) != 0) {
+            TTSLOG_ERROR("Couldn't write clip \"%s\" (%zu/%zu bytes)", path.c_str(), written, expected);
+            unlink(tmpPath.c_str());
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_index || m_index->version != version)
+        return;
+
+    uint64_t keyHash = hash(key.data(), key.size(), version);
+    IndexRecord *record = findRecord(keyHash);
+    if(record && record->contentHash == contentHash)
+        return;
+    removeRecord(record);
+
+    // The file of this clip is kept by sweep() once the record refers to it
+    record = allocateRecord(size);
+    if(!record) {
+        if(m_contentRefs.find(contentHash) == m_contentRefs.end())
+            m_unreferenced.push_back(contentHash);
+        return;
+    }
+
+    record->keyHash = keyHash;
+    record->contentHash = contentHash;
+    record->size = size;
+    record->lastUsed = ++m_index->clock;
+    record->flags = RECORD_VALID; // Published last
+    addRecord(record - m_records);
+    m_stats.writes++;
+
+    TTSLOG_VERBOSE("Stored clip of %zu bytes as \"%s\"", size, path.c_str());
+}
+
+TTSClipStore::Statistics TTSClipStore::statistics() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+} // namespace TTS
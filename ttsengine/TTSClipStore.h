@@ -0,0 +1,117 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_CLIP_STORE_H_
+#define _TTS_CLIP_STORE_H_
+
+#include "TTSAudioCache.h"
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace TTS {
+
+// Persistent store of synthesized audio, so that the clips survive TTSEngine restarts.
+//
+// <directory>/index is a memory mapped table of fixed size records (key hash, content
+// hash, size, last use), the audio itself lives in <directory>/<content hash>.clip
+// files which are memory mapped again for playback. Records are tagged with the
+// version of the configuration (endpoint, voice & language) they were fetched with,
+// a version change drops all the stale records.
+//
+// The index is looked up through in-memory tables (key hash => record, content hash
+// => references & a LRU list of the records) built when it is opened. Files of the
+// dropped records are removed later by sweep(), off the caller's thread.
+class TTSClipStore {
+public:
+    struct Statistics {
+        Statistics() : hits(0), misses(0), writes(0), evictions(0), entries(0), bytes(0), maxBytes(0) {}
+
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t writes;
+        uint64_t evictions;
+        uint32_t entries;
+        uint64_t bytes;
+        uint64_t maxBytes;
+    };
+
+    TTSClipStore(const std::string &directory, size_t maxBytes, uint32_t maxEntries);
+    ~TTSClipStore();
+
+    bool isEnabled() { return m_index != NULL; }
+
+    // Records of other versions are removed from the index, their files by sweep()
+    void setVersion(uint64_t version);
+
+    // Removes (a batch of) the files no record refers to anymore, called by the fetcher
+    void sweep();
+
+    // Maps the stored audio of the key, the chunk keeps the mapping alive
+    bool lookup(const std::string &key, AudioChunk &chunk);
+
+    // Writes a completely fetched clip to the disk
+    void insert(const AudioClipPtr &clip);
+
+    Statistics statistics();
+
+    // 64 bit FNV-1a, pass the previous result as seed to hash in pieces
+    static uint64_t hash(const char *data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+private:
+    struct IndexHeader;
+    struct IndexRecord;
+
+    std::string m_directory;
+    size_t m_maxBytes;
+    uint32_t m_maxEntries;
+    IndexHeader *m_index;
+    IndexRecord *m_records;
+    size_t m_indexSize;
+    Statistics m_stats;
+    std::mutex m_mutex;
+
+    // Valid records by key hash, references of the files & the LRU order (most recent first)
+    std::unordered_map<uint64_t, uint32_t> m_slots;
+    std::unordered_map<uint64_t, uint32_t> m_contentRefs;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<uint32_t> m_lruPrev;
+    std::vector<uint32_t> m_lruNext;
+    uint32_t m_lruHead;
+    uint32_t m_lruTail;
+    std::vector<uint64_t> m_unreferenced; // Content hashes of the files to sweep
+
+    bool openIndex();
+    void closeIndex();
+    IndexRecord *findRecord(uint64_t keyHash);
+    IndexRecord *allocateRecord(size_t size);
+    void addRecord(uint32_t slot);
+    void removeRecord(IndexRecord *record);
+    void touchRecord(IndexRecord *record);
+    void lruUnlink(uint32_t slot);
+    void lruPushFront(uint32_t slot);
+    std::string clipPath(uint64_t contentHash);
+};
+
+} // namespace TTS
+
+#endif
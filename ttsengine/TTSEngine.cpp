@@ -20,6 +20,7 @@
 #include "TTSSpeaker.h"
 #include "TTSSession.h"
 #include "TTSManager.h"
+#include "TTSEventDispatcher.h"
 
 #include "logger.h"
 #include "glib_utils.h"
@@ -31,6 +32,7 @@
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
 #include <gst/audio/audio.h>
+#include <curl/curl.h>
 
 #ifdef USE_BREAKPAD
 #include "breakpad_wrapper.h"
@@ -58,27 +60,30 @@ int main() {
     breakpad_ExceptionHandler();
 #endif
 
-    int pipefd[2];
     GSource *source = NULL;
 
     /* start the gmain loop */
     gLoop = g_main_loop_new(g_main_context_default(), FALSE);
 
     PRINT_CONFIG("TTS_DEFAULT_LOG_LEVEL");
+    PRINT_CONFIG("TTS_SYNC_LOGGING");
+    PRINT_CONFIG("TTS_LOG_RATE_LIMIT");
     PRINT_CONFIG("TTS_ENGINE_RT_LOG_LEVEL");
     PRINT_CONFIG("TTS_ENGINE_TEST_CLEANUP");
     PRINT_CONFIG("MAX_PIPELINE_FAILURE_THRESHOLD");
+    PRINT_CONFIG("TTS_AUDIO_SINK");
+    PRINT_CONFIG("TTS_RT_DISPATCH_BUDGET_MS");
 
     // Initialization
     logger_init();
     rtLogSetLevel(getenv("TTS_ENGINE_RT_LOG_LEVEL") ? (rtLogLevel)atoi(getenv("TTS_ENGINE_RT_LOG_LEVEL")) : RT_LOG_INFO);
 
     // Install rt message dispatcher
-    if(pipe(pipefd) == -1) {
-        TTSLOG_ERROR("Can't create pipe, exiting app");
+    source = installRtRemoteMessageHandler(g_main_loop_get_context(gLoop));
+    if(!source) {
+        TTSLOG_ERROR("Can't install rt message dispatcher, exiting app");
         return 1;
     }
-    source = installRtRemoteMessageHandler(pipefd, g_main_loop_get_context(gLoop));
 
     rtError e = rtRemoteInit();
     if (e != RT_OK)
@@ -88,6 +93,7 @@ int main() {
     }
 
     gst_init(NULL, NULL);
+    curl_global_init(CURL_GLOBAL_DEFAULT);
 
     // Register Manager Remote Object
     rtObjectRef rtObj(new TTSManager);
@@ -107,12 +113,11 @@ int main() {
     }
 
     g_main_loop_run(gLoop);
+    TTSEventDispatcher::instance().shutdown();
     rtRemoteShutdown();
+    curl_global_cleanup();
     gst_deinit();
 
-    if(source)
-        g_source_unref(source);
-    close(pipefd[0]);
-    close(pipefd[1]);
+    uninstallRtRemoteMessageHandler(source);
 }
 
@@ -0,0 +1,114 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include "TTSEventDispatcher.h"
+#include "TTSEventSource.h"
+#include "TTSSpeaker.h"
+#include "logger.h"
+
+#include <algorithm>
+
+namespace TTS {
+
+#define DEFAULT_EVENT_WORKERS 2
+#define DEFAULT_EVENT_QUEUE_DEPTH 64
+#define DEFAULT_EVENT_DEADLINE 500
+
+static long intFromConfig(const char *key, long defaultValue) {
+    auto it = TTSConfiguration::m_others.find(key);
+    if(it != TTSConfiguration::m_others.end() && !it->second.empty())
+        return std::atol(it->second.c_str());
+    return defaultValue;
+}
+
+TTSEventDispatcher &TTSEventDispatcher::instance() {
+    static TTSEventDispatcher dispatcher;
+    return dispatcher;
+}
+
+TTSEventDispatcher::TTSEventDispatcher() :
+    m_runThread(true),
+    m_queueDepth(std::max(1L, intFromConfig("EventQueueDepth", DEFAULT_EVENT_QUEUE_DEPTH))),
+    m_deadline(std::max(1L, intFromConfig("EventDeadline", DEFAULT_EVENT_DEADLINE))) {
+    long workers = std::max(1L, intFromConfig("EventWorkers", DEFAULT_EVENT_WORKERS));
+    TTSLOG_INFO("Event dispatcher with %ld workers, queue depth=%u, deadline=%ums", workers, m_queueDepth, m_deadline);
+
+    for(long i = 0; i < workers; ++i)
+        m_workers.push_back(new std::thread(DispatchThreadFunc, this));
+}
+
+TTSEventDispatcher::~TTSEventDispatcher() {
+    shutdown();
+}
+
+void TTSEventDispatcher::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_runThread = false;
+        m_condition.notify_all();
+    }
+
+    for(auto it = m_workers.begin(); it != m_workers.end(); ++it) {
+        (*it)->join();
+        delete *it;
+    }
+    m_workers.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sources.clear();
+}
+
+void TTSEventDispatcher::schedule(TTSEventSource *source) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_runThread)
+        return;
+    m_sources.push_back(rtObjectRef(source));
+    m_condition.notify_one();
+}
+
+void TTSEventDispatcher::DispatchThreadFunc(void *ctx) {
+    TTSEventDispatcher *dispatcher = (TTSEventDispatcher*)ctx;
+
+    TTSLOG_INFO("Starting EventDispatcherThread");
+
+    while(true) {
+        rtObjectRef source;
+        {
+            std::unique_lock<std::mutex> lock(dispatcher->m_mutex);
+            dispatcher->m_condition.wait(lock, [dispatcher] () {
+                    return !dispatcher->m_sources.empty() || !dispatcher->m_runThread;
+                    });
+            if(!dispatcher->m_runThread)
+                break;
+
+            source = dispatcher->m_sources.front();
+            dispatcher->m_sources.pop_front();
+        }
+
+        // Back to the end of the line, if it still has events
+        if(((TTSEventSource*)source.getPtr())->deliver()) {
+            std::lock_guard<std::mutex> lock(dispatcher->m_mutex);
+            dispatcher->m_sources.push_back(source);
+            dispatcher->m_condition.notify_one();
+        }
+    }
+
+    TTSLOG_INFO("Stopping EventDispatcherThread");
+}
+
+} // namespace TTS
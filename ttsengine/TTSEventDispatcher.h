@@ -0,0 +1,67 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_EVENT_DISPATCHER_H_
+#define _TTS_EVENT_DISPATCHER_H_
+
+#include <rtRemote.h>
+
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace TTS {
+
+class TTSEventSource;
+
+// Delivers the queued events of the event sources (sessions & manager) on worker threads,
+// so that a slow / hung client holds up only its own events, neither the main loop nor
+// the other clients. A source is drained by one worker at a time, keeping the event order,
+// and goes back to the end of the line after a few messages.
+class TTSEventDispatcher {
+public:
+    static TTSEventDispatcher &instance();
+
+    void schedule(TTSEventSource *source);
+
+    // Joins the workers, to be called before rtRemote is shut down (not from a worker)
+    void shutdown();
+
+    uint32_t queueDepth() const { return m_queueDepth; }     // Max queued events of a source
+    uint32_t deadline() const { return m_deadline; }         // Milli seconds, since queued
+
+private:
+    TTSEventDispatcher();
+    ~TTSEventDispatcher();
+
+    std::list<rtObjectRef> m_sources;       // Holds the sources alive till they are drained
+    std::vector<std::thread*> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_runThread;
+    const uint32_t m_queueDepth;
+    const uint32_t m_deadline;
+
+    static void DispatchThreadFunc(void *ctx);
+};
+
+} // namespace TTS
+
+#endif
@@ -18,33 +18,55 @@
 */
 
 #include "TTSEventSource.h"
+#include "TTSEventDispatcher.h"
 #include "TTSCommon.h"
 #include "logger.h"
 
+#include <iterator>
+
 namespace TTS {
 
 rtDefineObject(TTSEventSource, rtObject);
 rtDefineMethod(TTSEventSource, setListener);
 rtDefineMethod(TTSEventSource, delListener);
 
+void Event::set(rtString p, rtValue v) {
+    m_object.set(p, v);
+
+    EventField field { p.cString(), v.getType() == RT_stringType ? EVENT_FIELD_STRING : EVENT_FIELD_NUMBER, v.toString().cString() };
+    for(auto &f : m_fields) {
+        if(f.key == field.key) {
+            f = std::move(field);
+            return;
+        }
+    }
+    m_fields.push_back(std::move(field));
+}
+
+std::string Event::field(const char *key) const {
+    for(auto &f : m_fields) {
+        if(f.key == key)
+            return f.value;
+    }
+    return std::string();
+}
+
 rtError Emit::addListenerOrQueue(rtString eventName, const rtFunctionRef &f)
 {
-    if(!m_sendingEvents)
-        addListener(eventName, f);
-    else
-        m_addListenerQueue.push(EventHandler{eventName, f});
-
-    return RT_OK;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return addListener(eventName, f);
 }
 
 rtError Emit::delListenerOrQueue(rtString eventName, const rtFunctionRef &f)
 {
-    if(!m_sendingEvents)
-        delListener(eventName, f);
-    else
-        m_delListenerQueue.push(EventHandler{eventName, f});
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return delListener(eventName, f);
+}
 
-    return RT_OK;
+rtError Emit::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return clearListeners();
 }
 
 rtError Emit::Send(int numArgs,const rtValue* args,rtValue* result)
@@ -52,53 +74,49 @@ rtError Emit::Send(int numArgs,const rtValue* args,rtValue* result)
     (void)result;
     rtError error = RT_OK;
     if (numArgs > 0) {
-        m_sendingEvents = true;
         rtString eventName = args[0].toString();
-        std::vector<_rtEmitEntry>::iterator itr = mEntries.begin();
-
-        while(itr != mEntries.end()) {
-            _rtEmitEntry& entry = (*itr);
-            if(entry.n == eventName) {
-                rtValue discard;
-                // SYNC EVENTS
-                error = entry.f->Send(numArgs-1, args+1, &discard);
-                if (error != RT_OK)
-                    TTSLOG_INFO("failed to send. %s", rtStrError(error));
-
-                // EPIPE means it's disconnected
-                if(error == rtErrorFromErrno(EPIPE) || error == RT_ERROR_STREAM_CLOSED || discard == TTS_OBJECT_DESTROYED) {
-                    if(discard == TTS_OBJECT_DESTROYED)
-                        TTSLOG_INFO("Client Destroyed, removing handler");
-                    else
-                        TTSLOG_INFO("Broken entry in mEntries, removing handler");
-                    itr = mEntries.erase(itr);
-                } else {
-                    ++itr;
-                }
-            } else {
-                ++itr;
+        std::vector<rtFunctionRef> listeners;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for(auto &entry : mEntries) {
+                if(entry.n == eventName)
+                    listeners.push_back(entry.f);
             }
         }
 
-        m_sendingEvents = false;
-        EventHandler evtHandler;
+        for(auto &f : listeners) {
+            rtValue discard;
+            // SYNC EVENTS
+            error = f->Send(numArgs-1, args+1, &discard);
+            if (error != RT_OK)
+                TTSLOG_INFO("failed to send. %s", rtStrError(error));
 
-        while(m_addListenerQueue.size() > 0) {
-            evtHandler = m_addListenerQueue.front();
-            addListener(evtHandler.eventName, evtHandler.function);
-            m_addListenerQueue.pop();
-        }
+            // EPIPE means it's disconnected
+            if(error == rtErrorFromErrno(EPIPE) || error == RT_ERROR_STREAM_CLOSED || discard == TTS_OBJECT_DESTROYED) {
+                if(discard == TTS_OBJECT_DESTROYED)
+                    TTSLOG_INFO("Client Destroyed, removing handler");
+                else
+                    TTSLOG_INFO("Broken entry in mEntries, removing handler");
 
-        while(m_delListenerQueue.size() > 0) {
-            evtHandler = m_delListenerQueue.front();
-            delListener(evtHandler.eventName, evtHandler.function);
-            m_delListenerQueue.pop();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                delListener(eventName, f);
+            }
         }
     }
 
     return error;
 }
 
+bool Emit::hasListener(const rtString &eventName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto &entry : mEntries) {
+        if(entry.n == eventName)
+            return true;
+    }
+    return false;
+}
+
 rtError TTSEventSource::setListener(rtString eventName, const rtFunctionRef& f) {
     TTSLOG_WARNING("Add Listener for %s", eventName.cString());
 
@@ -114,78 +132,181 @@ rtError TTSEventSource::delListener(rtString eventName, const rtFunctionRef& f)
     return ((Emit*)m_emit.ptr())->delListenerOrQueue(eventName, f);
 }
 
-rtError TTSEventSource::sendEvent(Event& event) {
-    auto handleEvent = [](gpointer data) -> gboolean {
-        TTSEventSource& self = *static_cast<TTSEventSource*>(data);
-        rtObjectRef obj;
-
-        if (!self.m_eventQueue.empty()) {
-            {
-                std::lock_guard<std::mutex> lock(self.m_mutex);
-                obj = self.m_eventQueue.front();
-                self.m_eventQueue.pop();
-            }
+// Drops the pause / resume pairs & the repeated pause / resume of a speech and
+// merges the successive cancelled events
+static void coalesceEvents(std::vector<Event> &events) {
+    std::vector<Event> coalesced;
+    coalesced.reserve(events.size());
+
+    for(auto &event : events) {
+        const std::string &name = event.eventName();
+        if(name == "paused" || name == "resumed") {
+            std::string id = event.field("id");
+            auto last = coalesced.rbegin();
+            while(last != coalesced.rend() && last->field("id") != id)
+                ++last;
 
-            TTSLOG_WARNING("Sending event{name=%s}...", obj.get<rtString>("name").cString());
-            rtError rc = self.m_emit.send(obj.get<rtString>("name"), obj);
-            if (RT_OK != rc) {
-                TTSLOG_ERROR("Can't send event{name=%s} to all listeners, error code: %d", obj.get<rtString>("name").cString(), rc);
+            if(last != coalesced.rend() && last->eventName() == name)
+                continue;
+            if(last != coalesced.rend() && name == "resumed" && last->eventName() == "paused") {
+                coalesced.erase(std::next(last).base());
+                continue;
             }
+        } else if(name == "cancelled" && !coalesced.empty() && coalesced.back().eventName() == "cancelled") {
+            coalesced.back().set("ids", rtString((coalesced.back().field("ids") + "," + event.field("ids")).c_str()));
+            continue;
+        }
+        coalesced.push_back(event);
+    }
+
+    events.swap(coalesced);
+}
+
+void TTSEventSource::sendBatch(std::vector<Event> &events) {
+    size_t queued = events.size();
+    coalesceEvents(events);
+
+    // Only the events the client listens to (i.e extended events it requested)
+    Emit *emit = (Emit*)m_emit.ptr();
+    std::string batch;
+    size_t count = 0;
+    for(auto &event : events) {
+        if(emit->hasListener(event.eventName().c_str())) {
+            appendEventRecord(batch, event.eventName(), event.fields());
+            count++;
+        }
+    }
+
+    if(count == 0)
+        return;
+
+    TTSLOG_WARNING("Sending batch of %d events (%d queued)...", (int)count, (int)queued);
+    checkSendResult(m_emit.send(TTS_EVENT_BATCH, rtString(batch.data(), batch.size())), TTS_EVENT_BATCH);
+}
+
+void TTSEventSource::checkSendResult(rtError rc, const char *eventName) {
+    if (RT_OK != rc) {
+        TTSLOG_ERROR("Can't send event{name=%s} to all listeners, error code: %d", eventName, rc);
+    }
+
+    // if timeout occurs do not increment hang detector or stream is closed disable hang detection.
+    if (RT_ERROR_TIMEOUT == rc || rc == rtErrorFromErrno(EPIPE) || rc == RT_ERROR_STREAM_CLOSED) {
+        if (!m_isRemoteClientHanging) {
+            m_isRemoteClientHanging = true;
+            TTSLOG_WARNING("Remote client is entered to a hanging state");
+        }
+        if (rc == rtErrorFromErrno(EPIPE) || rc == RT_ERROR_STREAM_CLOSED) {
+            TTSLOG_WARNING("Remote client connection seems to be closed/broken");
+            // Clear the listeners here
+            ((Emit*)m_emit.ptr())->clear();
+        }
+    } else if (RT_OK == rc) {
+        if (m_isRemoteClientHanging) {
+            m_isRemoteClientHanging = false;
+            TTSLOG_WARNING("Remote client is recovered after the hanging state");
+        }
+    }
+}
 
-            // if timeout occurs do not increment hang detector or stream is closed disable hang detection.
-            if (RT_ERROR_TIMEOUT == rc || rc == rtErrorFromErrno(EPIPE) || rc == RT_ERROR_STREAM_CLOSED) {
-                if (!self.m_isRemoteClientHanging) {
-                    self.m_isRemoteClientHanging = true;
-                    TTSLOG_WARNING("Remote client is entered to a hanging state");
-                }
-                if (rc == rtErrorFromErrno(EPIPE) || rc == RT_ERROR_STREAM_CLOSED) {
-                    TTSLOG_WARNING("Remote client connection seems to be closed/broken");
-                    // Clear the listeners here
-                    self.m_emit->clearListeners();
-                }
-            } else if (RT_OK == rc) {
-                if (self.m_isRemoteClientHanging) {
-                    self.m_isRemoteClientHanging = false;
-                    TTSLOG_WARNING("Remote client is recovered after the hanging state");
-                }
+void TTSEventSource::recordDelivery(const std::vector<Event> &events) {
+    uint32_t deadline = TTSEventDispatcher::instance().deadline();
+    uint32_t late = 0;
+    for(auto &event : events) {
+        uint32_t elapsed = event.msSinceQueued();
+        if(elapsed > deadline) {
+            TTSLOG_WARNING("Event{name=%s} is delivered %ums after it was queued", event.eventName().c_str(), elapsed);
+            late++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.delivered += events.size();
+    m_statistics.late += late;
+}
+
+bool TTSEventSource::deliver() {
+    // Messages sent in a turn, before giving the dispatcher thread to the other sources
+    static const int MAX_MESSAGES_PER_TURN = 4;
+
+    for(int i = 0; i < MAX_MESSAGES_PER_TURN; ++i) {
+        bool batching = isBatching();
+        std::vector<Event> events;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_eventQueue.empty()) {
+                m_scheduled = false;
+                return false;
             }
 
-            {
-                if (!self.m_eventQueue.empty()) {
-                    std::lock_guard<std::mutex> lock(self.m_mutex);
-                    return G_SOURCE_CONTINUE;
-                }
+            if(batching) {
+                events.assign(std::make_move_iterator(m_eventQueue.begin()), std::make_move_iterator(m_eventQueue.end()));
+                m_eventQueue.clear();
+            } else {
+                events.push_back(std::move(m_eventQueue.front()));
+                m_eventQueue.pop_front();
             }
         }
 
-        {
-            std::lock_guard<std::mutex> lock(self.m_mutex);
-            self.m_timeoutId = 0;
+        if(batching) {
+            sendBatch(events);
+        } else {
+            rtObjectRef obj = events.front().object();
+            TTSLOG_WARNING("Sending event{name=%s}...", events.front().eventName().c_str());
+            rtError rc = m_emit.send(obj.get<rtString>("name"), obj);
+            checkSendResult(rc, events.front().eventName().c_str());
         }
-        return G_SOURCE_REMOVE;
-    };
+        recordDelivery(events);
+    }
 
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_eventQueue.push(event.object());
-        if (m_timeoutId == 0) {
-            m_timeoutId = g_timeout_add(0, handleEvent, (void*) this);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_scheduled = !m_eventQueue.empty();
+    return m_scheduled;
+}
+
+rtError TTSEventSource::sendEvent(Event& event) {
+    TTSEventDispatcher &dispatcher = TTSEventDispatcher::instance();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Queue is full (client is slow / hung), coalesce the queued events or else drop the oldest
+    if(m_eventQueue.size() >= dispatcher.queueDepth()) {
+        std::vector<Event> events(std::make_move_iterator(m_eventQueue.begin()), std::make_move_iterator(m_eventQueue.end()));
+        coalesceEvents(events);
+        m_eventQueue.assign(std::make_move_iterator(events.begin()), std::make_move_iterator(events.end()));
+
+        while(m_eventQueue.size() >= dispatcher.queueDepth()) {
+            TTSLOG_WARNING("Event queue is full, dropping event{name=%s}", m_eventQueue.front().eventName().c_str());
+            m_eventQueue.pop_front();
+            m_statistics.dropped++;
         }
     }
 
+    m_eventQueue.push_back(event);
+    m_eventQueue.back().markQueued();
+
+    if(!m_scheduled) {
+        m_scheduled = true;
+        dispatcher.schedule(this);
+    }
+
     return RT_OK;
 }
 
 void TTSEventSource::clear()
 {
-    if (m_timeoutId != 0) {
-        g_source_remove(m_timeoutId);
-        m_timeoutId = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_eventQueue.clear();
     }
 
-    m_eventQueue = std::queue<rtObjectRef>();
-    m_emit->clearListeners();
+    ((Emit*)m_emit.ptr())->clear();
 }
 
-} // namespace TTS
+TTSEventSource::Statistics TTSEventSource::eventStatistics() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.queued = m_eventQueue.size();
+    return statistics;
+}
 
+} // namespace TTS
@@ -22,44 +22,59 @@
 #include <glib.h>
 #include <rtRemote.h>
 
-#include <queue>
+#include <deque>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "TTSEventBatch.h"
 
 namespace TTS {
 
+// The fields are kept flat too, to be sent in an event batch without reaching the object
 class Event
 {
 public:
-    Event(const char* eventName) : m_object(new rtMapObject) {
+    Event(const char* eventName) : m_object(new rtMapObject), m_name(eventName), m_queued(std::chrono::steady_clock::now()) {
         m_object.set("name", eventName);
     }
 
     rtObjectRef object() const { return m_object; }
-    void set(rtString p, rtValue v) { m_object.set(p, v); }
+    void set(rtString p, rtValue v);
     rtString name() const { return m_object.get<rtString>("name"); }
 
+    const std::string &eventName() const { return m_name; }
+    const std::vector<EventField> &fields() const { return m_fields; }
+    std::string field(const char *key) const;
+
+    void markQueued() { m_queued = std::chrono::steady_clock::now(); }
+    uint32_t msSinceQueued() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_queued).count();
+    }
+
 private:
     rtObjectRef m_object;
+    std::string m_name;
+    std::vector<EventField> m_fields;
+    std::chrono::steady_clock::time_point m_queued;
 };
 
+// Listeners can be added / removed while an event is being sent from a dispatcher thread,
+// the events are sent to a copy of the listeners, so that a slow listener doesn't block them
 class Emit : public rtEmit {
 public:
-    Emit() : m_sendingEvents(false) {}
+    Emit() {}
 
     rtError addListenerOrQueue(rtString eventName, const rtFunctionRef &f);
     rtError delListenerOrQueue(rtString eventName, const rtFunctionRef &f);
+    rtError clear();
 
     virtual rtError Send(int numArgs,const rtValue* args,rtValue* result) override;
+    bool hasListener(const rtString &eventName);
 
 private:
-    bool m_sendingEvents;
-
-    struct EventHandler {
-        rtString eventName;
-        rtFunctionRef function;
-    };
-    std::queue<EventHandler> m_addListenerQueue;
-    std::queue<EventHandler> m_delListenerQueue;
+    std::mutex m_mutex;
 };
 
 class TTSEventSource : public rtObject {
@@ -73,25 +88,43 @@ public:
 
     TTSEventSource() :
         m_emit(new Emit()),
-        m_timeoutId(0),
+        m_scheduled(false),
         m_isRemoteClientHanging(false) {
     }
 
-    ~TTSEventSource() {
-        if (m_timeoutId != 0)
-            g_source_remove(m_timeoutId);
-    }
+    ~TTSEventSource() {}
+
+    struct Statistics {
+        Statistics() : queued(0), delivered(0), dropped(0), late(0) {}
+
+        uint32_t queued;        // Events waiting to be sent
+        uint64_t delivered;
+        uint64_t dropped;       // Oldest events dropped, when the queue was full
+        uint64_t late;          // Events sent after the deadline (since queued)
+    };
 
     rtError sendEvent(Event& event);
     bool isRemoteClientHanging() const { return m_isRemoteClientHanging; }
     void clear();
+    Statistics eventStatistics();
+
+    // Called by TTSEventDispatcher, sends a few messages & returns true if more events are pending
+    bool deliver();
 
 private:
     rtEmitRef m_emit;
     std::mutex m_mutex;
-    std::queue<rtObjectRef> m_eventQueue;
-    int m_timeoutId;
-    bool m_isRemoteClientHanging;
+    std::deque<Event> m_eventQueue;
+    bool m_scheduled;                           // In TTSEventDispatcher, till the queue is drained
+    std::atomic<bool> m_isRemoteClientHanging;
+    Statistics m_statistics;
+
+    // When the client listens to TTS_EVENT_BATCH, all the queued events are coalesced
+    // & sent in one message
+    bool isBatching() { return ((Emit*)m_emit.ptr())->hasListener(TTS_EVENT_BATCH); }
+    void sendBatch(std::vector<Event> &events);
+    void checkSendResult(rtError rc, const char *eventName);
+    void recordDelivery(const std::vector<Event> &events);
 };
 
 } // namespace TTS
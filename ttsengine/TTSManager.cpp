@@ -19,6 +19,7 @@
 
 #include "TTSManager.h"
 #include "logger.h"
+#include "rt_msg_dispatcher.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,10 +27,12 @@
 #include <sys/un.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
 
 #include <iostream>
 #include <fstream>
-#include <regex>
+#include <sstream>
 #include <map>
 #include <set>
 
@@ -39,6 +42,9 @@ extern GMainLoop* gLoop;
 
 #define TTS_CONFIGURATION_FILE "/opt/tts/tts.ini"
 #define RESERVATION_POLICY_STRING "Reservation"
+#define PRIORITY_POLICY_STRING "Priority"
+
+#define MONITOR_EVENTS_PER_WAKEUP 64
 
 #define _return(tts_code) result.setUInt8(tts_code); return RT_OK;
 
@@ -69,6 +75,8 @@ rtDefineMethod(TTSManager, listVoices);
 rtDefineMethod(TTSManager, setConfiguration);
 rtDefineMethod(TTSManager, getConfiguration);
 rtDefineMethod(TTSManager, isSessionActiveForApp);
+rtDefineMethod(TTSManager, getCacheStatistics);
+rtDefineMethod(TTSManager, getStatistics);
 
 rtDefineMethod(TTSManager, createSession);
 rtDefineMethod(TTSManager, destroySession);
@@ -84,10 +92,117 @@ uint32_t nextSessionId() {
     return ++counter;
 }
 
+void TTSManager::startClientMonitor() {
+    TTSLOG_TRACE("TTSManager::startClientMonitor");
+
+    struct sockaddr_un addr;
+    if ( (m_monitorFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+        TTSLOG_ERROR("socket error");
+        exit(-1);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, CLIENT_MONITOR_SOCKET_PATH, sizeof(addr.sun_path)-1);
+    unlink(CLIENT_MONITOR_SOCKET_PATH);
+
+    if (bind(m_monitorFd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        TTSLOG_ERROR("bind error");
+        exit(-1);
+    }
+
+    // Clients connect in a burst at boot
+    if (listen(m_monitorFd, SOMAXCONN) == -1) {
+        TTSLOG_ERROR("listen error");
+        exit(-1);
+    }
+
+    // The listening socket & the connections are polled through one epoll fd, a single source on the main loop
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_monitorFd;
+    if ( (m_monitorPollFd = epoll_create1(EPOLL_CLOEXEC)) == -1 ||
+        epoll_ctl(m_monitorPollFd, EPOLL_CTL_ADD, m_monitorFd, &event) == -1) {
+        TTSLOG_ERROR("epoll error : %s", strerror(errno));
+        exit(-1);
+    }
+
+    m_monitorSource = create_and_setup_source(m_monitorPollFd, MonitorClientsSourceIOCB, NullCB, this);
+    g_source_attach(m_monitorSource, g_main_loop_get_context(gLoop));
+}
+
+void TTSManager::stopClientMonitor() {
+    if(m_monitorSource) {
+        g_source_destroy(m_monitorSource);
+        g_source_unref(m_monitorSource);
+        m_monitorSource = NULL;
+    }
+
+    for(auto it = m_connectionSession.begin(); it != m_connectionSession.end(); ++it)
+        close(it->first);
+    m_connectionSession.clear();
+    m_sessionConnection.clear();
+
+    if(m_monitorPollFd != -1) {
+        close(m_monitorPollFd);
+        m_monitorPollFd = -1;
+    }
+
+    if(m_monitorFd != -1) {
+        close(m_monitorFd);
+        m_monitorFd = -1;
+        unlink(CLIENT_MONITOR_SOCKET_PATH);
+    }
+}
+
+void TTSManager::acceptClients() {
+    // Bounded, the pending ones keep the listening socket readable for the next iteration
+    for(int i = 0; i < MONITOR_EVENTS_PER_WAKEUP; ++i) {
+        int connectedFd = accept4(m_monitorFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(connectedFd == -1) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                TTSLOG_ERROR("accept error : %s", strerror(errno));
+            return;
+        }
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = connectedFd;
+        if(epoll_ctl(m_monitorPollFd, EPOLL_CTL_ADD, connectedFd, &event) == -1) {
+            TTSLOG_ERROR("Can't monitor fd=%d : %s", connectedFd, strerror(errno));
+            close(connectedFd);
+            continue;
+        }
+
+        TTSLOG_INFO("New session connected with fd=%d", connectedFd);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connectionSession[connectedFd] = 0;
+    }
+}
+
+uint32_t TTSManager::closeConnection(int fd) {
+    epoll_ctl(m_monitorPollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+
+    uint32_t sessionId = 0;
+    auto it = m_connectionSession.find(fd);
+    if(it != m_connectionSession.end()) {
+        sessionId = it->second;
+        m_connectionSession.erase(it);
+    }
+
+    auto sit = m_sessionConnection.find(sessionId);
+    if(sit != m_sessionConnection.end() && sit->second == fd)
+        m_sessionConnection.erase(sit);
+
+    return sessionId;
+}
+
 void TTSManager::MonitorClientsSourceIOCB(void *source, void *ctx) {
     TTSLOG_TRACE("TTSManager::MonitorClientsSourceIOCB");
 
-    char buf[256];
     EventSource *s = (EventSource*)source;
     TTSManager *manager = (TTSManager*)ctx;
 
@@ -96,163 +211,281 @@ void TTSManager::MonitorClientsSourceIOCB(void *source, void *ctx) {
         return;
     }
 
-    int rc = read(s->pfd.fd,buf,sizeof(buf));
-    if(rc > 0) {
-        buf[rc] = '\0';
-        TTSLOG_VERBOSE("Read %d bytes from fd=%d, data=%s", rc, s->pfd.fd, buf);
+    // Level triggered, what isn't handled now wakes the loop up again
+    struct epoll_event events[MONITOR_EVENTS_PER_WAKEUP];
+    int count = epoll_wait(s->pfd.fd, events, MONITOR_EVENTS_PER_WAKEUP, 0);
+    for(int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if(fd == manager->m_monitorFd) {
+            manager->acceptClients();
+            continue;
+        }
+
+        // Closed already, while handling an earlier event of the batch
+        {
+            std::lock_guard<std::mutex> lock(manager->m_mutex);
+            if(manager->m_connectionSession.find(fd) == manager->m_connectionSession.end())
+                continue;
+        }
+
+        bool closed = (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP));
+        if(events[i].events & EPOLLIN) {
+            char buf[256];
+            int rc = read(fd, buf, sizeof(buf) - 1);
+            if(rc > 0) {
+                buf[rc] = '\0';
+                TTSLOG_VERBOSE("Read %d bytes from fd=%d, data=%s", rc, fd, buf);
+
+                // Update TTSManager's connection index
+                uint32_t sessionId = std::atol(buf);
+                std::lock_guard<std::mutex> lock(manager->m_mutex);
+                manager->m_connectionSession[fd] = sessionId;
+                manager->m_sessionConnection[sessionId] = fd;
+            } else if(rc == 0 || (errno != EAGAIN && errno != EINTR)) {
+                closed = true;
+            }
+        }
+
+        if(closed) {
+            uint32_t sessionId;
+            {
+                std::lock_guard<std::mutex> lock(manager->m_mutex);
+                sessionId = manager->closeConnection(fd);
+            }
 
-        // Update TTSManager's connection map
-        s->sessionId = std::atol(buf);
-        manager->m_connectionMap[s->pfd.fd] = s;
+            TTSLOG_WARNING("Connection with fd=%d is closed, its session \"%u\" will be destroyed", fd, sessionId);
+
+            // Remove the session from TTSManager
+            if(sessionId) {
+                rtValue result;
+                manager->destroySession(sessionId, result);
+            }
+        }
     }
 }
 
-void TTSManager::MonitorClientsSourceDestroyedCB(void *source, void *ctx) {
-    TTSLOG_TRACE("TTSManager::MonitorClientsSourceDestroyedCB");
+// -------------------------
 
-    EventSource *s = (EventSource*)source;
-    TTSManager *manager = (TTSManager*)ctx;
+// Matches "<key> = <value>[ anything]", key being [a-zA-Z0-9_-]+ & value running till a space
+static bool parseConfigurationLine(const std::string &line, std::string &key, std::string &value) {
+    size_t i = 0;
+    while(i < line.size() && isspace(line[i]))
+        ++i;
 
-    if(!s || !manager) {
-        TTSLOG_WARNING("Null Source | Null Manager in %s", __FUNCTION__);
-        return;
-    }
+    size_t keyStart = i;
+    while(i < line.size() && (isalnum(line[i]) || line[i] == '_' || line[i] == '-'))
+        ++i;
+    if(i == keyStart)
+        return false;
+    size_t keyEnd = i;
 
-    TTSLOG_WARNING("Source with fd=%d is closed, its session \"%u\" will be destroyed",
-            s->pfd.fd, s->sessionId);
+    while(i < line.size() && isspace(line[i]))
+        ++i;
+    if(i == line.size() || line[i] != '=')
+        return false;
+    ++i;
+    while(i < line.size() && isspace(line[i]))
+        ++i;
+
+    size_t valueStart = i;
+    while(i < line.size() && line[i] != ' ')
+        ++i;
+    if(i == valueStart)
+        return false;
 
-    // Remove the session from TTSManager
-    rtValue result;
-    manager->destroySession(s->sessionId, result);
+    key.assign(line, keyStart, keyEnd - keyStart);
+    value.assign(line, valueStart, i - valueStart);
+    return true;
 }
 
-void TTSManager::MonitorClients(void *ctx) {
-    TTSLOG_TRACE("TTSManager::MonitorClients");
+bool TTSManager::loadConfigurationsFromFile(rtString configFileName, bool reload) {
+    TTSLOG_TRACE("Reading configuration file");
 
-    TTSManager* manager = (TTSManager*)ctx;
-    struct sockaddr_un addr;
-    int serverFd, connectedFd;
+    // Read configuration file and update the configuration
+    std::ifstream configFile(configFileName, std::ios::in);
 
-    TTSLOG_INFO("Starting thread...");
-    if ( (serverFd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
-        TTSLOG_ERROR("socket error");
-        exit(-1);
+    if(!configFile.is_open()) {
+        TTSLOG_ERROR("Configuration file \"%s\" is not found, using %s", configFileName.cString(),
+                reload ? "the current configuration" : "defaults");
+        return false;
     }
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, CLIENT_MONITOR_SOCKET_PATH, sizeof(addr.sun_path)-1);
-    unlink(CLIENT_MONITOR_SOCKET_PATH);
+    std::string line, key, value;
+    std::map<std::string, std::string> configSet;
+    while(std::getline(configFile, line)) {
+        if(parseConfigurationLine(line, key, value))
+            configSet[key] = value;
+    }
+    configFile.close();
 
-    if (bind(serverFd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        TTSLOG_ERROR("bind error");
-        exit(-1);
+    TTSConfigurationUpdate update;
+    std::map<std::string, std::string>::iterator it;
+    if((it = configSet.find("TTSEndPoint")) != configSet.end()) {
+        update.setEndPoint(it->second.c_str());
+        configSet.erase(it);
     }
 
-    if (listen(serverFd, 10) == -1) {
-        TTSLOG_ERROR("listen error");
-        exit(-1);
+    if((it = configSet.find("SecureTTSEndPoint")) != configSet.end()) {
+        update.setSecureEndPoint(it->second.c_str());
+        configSet.erase(it);
     }
 
-    while (manager && manager->m_monitorClients) {
-        if ( (connectedFd = accept(serverFd, NULL, NULL)) == -1) {
-            TTSLOG_ERROR("accept error : %s", strerror(errno));
-            continue;
-        }
+    if((it = configSet.find("Language")) != configSet.end()) {
+        update.setLanguage(it->second.c_str());
+        configSet.erase(it);
+    }
 
-        TTSLOG_INFO("New session connected with fd=%d", connectedFd);
-        GSource *gs = create_and_setup_source(connectedFd, MonitorClientsSourceIOCB, MonitorClientsSourceDestroyedCB, manager);
-        g_source_attach(gs, g_main_loop_get_context(gLoop));
+    if((it = configSet.find("Voice")) != configSet.end()) {
+        update.setVoice(it->second.c_str());
+        configSet.erase(it);
     }
 
-    TTSLOG_INFO("Exiting thread...");
-    close(serverFd);
-    unlink(CLIENT_MONITOR_SOCKET_PATH);
-}
+    if((it = configSet.find("Volume")) != configSet.end()) {
+        update.setVolume(std::atof(it->second.c_str()));
+        configSet.erase(it);
+    }
 
-// -------------------------
+    if((it = configSet.find("Rate")) != configSet.end()) {
+        update.setRate(std::atoi(it->second.c_str()));
+        configSet.erase(it);
+    }
 
-TTSConfiguration& TTSManager::loadConfigurationsFromFile(rtString configFileName) {
-    TTSLOG_TRACE("Reading configuration file");
+    std::map<std::string, std::string> languageVoices;
+    for(it = configSet.begin(); it != configSet.end(); ) {
+        if(it->first.find("voice_for_") == 0) {
+            languageVoices.insert(*it);
+            it = configSet.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    update.setLanguageVoices(std::move(languageVoices));
+
+    ResourceAllocationPolicy policy = OPEN;
+    if((it = configSet.find("ResourceAccessPolicy")) != configSet.end()) {
+        std::string &policyStr = it->second;
+        if(!policyStr.empty() && policyStr == RESERVATION_POLICY_STRING)
+            policy = RESERVATION;
+        else if(!policyStr.empty() && policyStr == PRIORITY_POLICY_STRING)
+            policy = PRIORITY;
+        configSet.erase(it);
+    }
 
-    // Read configuration file and update m_defaultConfiguration
-    std::ifstream configFile(configFileName, std::ios::in);
+    if(reload) {
+        // Rest of the keys are read by the components as they start
+        if(policy != m_policy)
+            TTSLOG_WARNING("ResourceAccessPolicy change takes effect only after a restart");
+        if(configSet != TTSConfiguration::m_others)
+            TTSLOG_WARNING("Keys other than the endpoints, language, voice(s), volume & rate take effect only after a restart");
 
-    if(configFile.is_open()) {
-        std::cmatch m;
-        std::string line;
-        std::map<std::string, std::string> configSet;
-        std::regex re("\\s*([a-zA-Z0-9_-]+)\\s*=\\s*([^ ]+).*$");
-
-        while(1) {
-            if(std::getline(configFile, line)) {
-                if(!line.empty() && std::regex_match(line.c_str(), m, re) && m.size() >= 3)
-                    configSet[m[1].str()] = m[2].str();
-            } else
-                break;
-        }
+        if(!updateConfiguration(update))
+            TTSLOG_INFO("Configuration file is reloaded, nothing changed");
+        return true;
+    }
 
-        std::map<std::string, std::string>::iterator it;
-        if((it = configSet.find("TTSEndPoint")) != configSet.end()) {
-            m_defaultConfiguration.setEndPoint(it->second.c_str());
-            configSet.erase(it);
-        }
+    m_configuration.update(update);
+    setResourceAllocationPolicy(policy);
+    TTSConfiguration::m_others = std::move(configSet);
 
-        if((it = configSet.find("SecureTTSEndPoint")) != configSet.end()) {
-            m_defaultConfiguration.setSecureEndPoint(it->second.c_str());
-            configSet.erase(it);
-        }
+    TTSConfigurationPtr config = m_configuration.current();
+    TTSLOG_WARNING("TTSEndPoint : %s", config->endPoint().cString());
+    TTSLOG_WARNING("SecureTTSEndPoint : %s", config->secureEndPoint().cString());
+    TTSLOG_WARNING("Language : %s", config->language().cString());
+    TTSLOG_WARNING("Voice : %s", config->voice().cString());
+    TTSLOG_WARNING("Volume : %lf", config->volume());
+    TTSLOG_WARNING("Rate : %u", config->rate());
 
-        if((it = configSet.find("Language")) != configSet.end()) {
-            m_defaultConfiguration.setLanguage(it->second.c_str());
-            configSet.erase(it);
-        }
+    for(auto oit = config->languageVoices().begin(); oit != config->languageVoices().end(); ++oit)
+        TTSLOG_WARNING("%s : %s", oit->first.c_str(), oit->second.c_str());
+    for(auto oit = TTSConfiguration::m_others.begin(); oit != TTSConfiguration::m_others.end(); ++oit)
+        TTSLOG_WARNING("%s : %s", oit->first.c_str(), oit->second.c_str());
 
-        if((it = configSet.find("Voice")) != configSet.end()) {
-            m_defaultConfiguration.setVoice(it->second.c_str());
-            configSet.erase(it);
-        }
+    return true;
+}
 
-        if((it = configSet.find("Volume")) != configSet.end()) {
-            m_defaultConfiguration.setVolume(std::stod(it->second));
-            configSet.erase(it);
-        }
+uint32_t TTSManager::updateConfiguration(const TTSConfigurationUpdate &update) {
+    TTSConfigurationPtr previous = m_configuration.current();
+    uint32_t changed = m_configuration.update(update);
+    if(!changed)
+        return 0;
+
+    // Sessions share the snapshot, nothing is copied to them
+    TTSConfigurationPtr config = m_configuration.current();
+    TTSLOG_INFO("Default config updated (version=%llu, changed=0x%x), endPoint=%s, secureEndPoint=%s, lang=%s, voice=%s, vol=%lf, rate=%u",
+            (unsigned long long)config->version(), changed,
+            config->endPoint().cString(),
+            config->secureEndPoint().cString(),
+            config->language().cString(),
+            config->voice().cString(),
+            config->volume(),
+            config->rate());
+
+    if(config->endPoint().isEmpty() && config->secureEndPoint().isEmpty())
+        TTSLOG_WARNING("TTSEndPoint & SecureTTSEndPoints are empty!!!");
 
-        if((it = configSet.find("Rate")) != configSet.end()) {
-            m_defaultConfiguration.setRate(std::stoi(it->second));
-            configSet.erase(it);
-        }
+    // Audio fetched so far doesn't belong to the new configuration, volume & rate changes don't matter
+    if(previous->voice() != config->voice() || previous->language() != config->language() ||
+        previous->endPoint() != config->endPoint() || previous->secureEndPoint() != config->secureEndPoint())
+        m_speaker->configurationChanged();
 
-        ResourceAllocationPolicy policy = OPEN;
-        if((it = configSet.find("ResourceAccessPolicy")) != configSet.end()) {
-            std::string &policyStr = it->second;
-            if(!policyStr.empty() && policyStr == RESERVATION_POLICY_STRING)
-                policy = RESERVATION;
-            configSet.erase(it);
-        }
-        setResourceAllocationPolicy(policy);
+    if(previous->voice() != config->voice()) {
+        Event d("voice_changed");
+        d.set("voice", config->voice());
+        sendEvent(d);
+    }
 
-        m_defaultConfiguration.m_others = std::move(configSet);
+    return changed;
+}
 
-        configFile.close();
-    } else {
-        TTSLOG_ERROR("Configuration file \"%s\" is not found, using defaults", configFileName.cString());
+void TTSManager::watchConfigurationFile() {
+    // Directory is watched, as the editors replace the file
+    std::string path(TTS_CONFIGURATION_FILE);
+    std::string directory = path.substr(0, path.rfind('/'));
+
+    m_configWatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_configWatchFd == -1 ||
+        inotify_add_watch(m_configWatchFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+        TTSLOG_WARNING("Can't watch \"%s\", configuration file won't be reloaded", directory.c_str());
+        if(m_configWatchFd != -1)
+            close(m_configWatchFd);
+        m_configWatchFd = -1;
+        return;
     }
 
-    TTSLOG_WARNING("TTSEndPoint : %s", m_defaultConfiguration.endPoint().cString());
-    TTSLOG_WARNING("SecureTTSEndPoint : %s", m_defaultConfiguration.secureEndPoint().cString());
-    TTSLOG_WARNING("Language : %s", m_defaultConfiguration.language().cString());
-    TTSLOG_WARNING("Voice : %s", m_defaultConfiguration.voice().cString());
-    TTSLOG_WARNING("Volume : %lf", m_defaultConfiguration.volume());
-    TTSLOG_WARNING("Rate : %u", m_defaultConfiguration.rate());
+    m_configWatch = create_and_setup_source(m_configWatchFd, ConfigurationWatchIOCB, NullCB, this);
+    g_source_attach(m_configWatch, g_main_loop_get_context(gLoop));
+}
+
+void TTSManager::ConfigurationWatchIOCB(void *source, void *ctx) {
+    TTSLOG_TRACE("TTSManager::ConfigurationWatchIOCB");
+
+    EventSource *s = (EventSource*)source;
+    TTSManager *manager = (TTSManager*)ctx;
 
-    auto it = m_defaultConfiguration.m_others.begin();
-    while( it != m_defaultConfiguration.m_others.end()) {
-        TTSLOG_WARNING("%s : %s", it->first.c_str(), it->second.c_str());
-        ++it;
+    if(!s || !manager) {
+        TTSLOG_WARNING("Null Source | Null Manager in %s", __FUNCTION__);
+        return;
+    }
+
+    std::string path(TTS_CONFIGURATION_FILE);
+    std::string name = path.substr(path.rfind('/') + 1);
+
+    bool changed = false;
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while((len = read(s->pfd.fd, buf, sizeof(buf))) > 0) {
+        for(char *ptr = buf; ptr < buf + len; ) {
+            struct inotify_event *event = (struct inotify_event*)ptr;
+            if(event->len && name == event->name)
+                changed = true;
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
     }
 
-    return m_defaultConfiguration;
+    if(changed) {
+        TTSLOG_WARNING("Configuration file \"%s\" changed, reloading", TTS_CONFIGURATION_FILE);
+        manager->loadConfigurationsFromFile(TTS_CONFIGURATION_FILE, true);
+    }
 }
 
 TTSManager::TTSManager() :
@@ -262,20 +495,28 @@ TTSManager::TTSManager() :
     m_claimedApp(0),
     m_activeSession(NULL),
     m_speaker(NULL),
-    m_thread(NULL),
-    m_monitorClients(true),
+    m_monitorFd(-1),
+    m_monitorPollFd(-1),
+    m_monitorSource(NULL),
     m_claimedSession(false),
-    m_ttsEnabled(false) {
+    m_ttsEnabled(false),
+    m_configWatchFd(-1),
+    m_configWatch(NULL) {
     TTSLOG_TRACE("TTSManager::TTSManager");
 
+    m_appMap.reserve(16);
+    m_sessionMap.reserve(16);
+
     // Load configuration from file
     loadConfigurationsFromFile(TTS_CONFIGURATION_FILE);
 
     // Setup Speaker passing the read configuration
-    m_speaker = new TTSSpeaker(m_defaultConfiguration);
+    m_speaker = new TTSSpeaker(m_configuration);
+    m_speaker->setPriorityScheduling(m_policy == PRIORITY);
+    watchConfigurationFile();
 
-    // Start client monitor thread
-    m_thread = new std::thread(MonitorClients, this);
+    // Start monitoring the clients' liveness
+    startClientMonitor();
 }
 
 TTSManager::~TTSManager() {
@@ -289,8 +530,22 @@ TTSManager::~TTSManager() {
     }
 
     // Clear All Sessions
-    m_sessionMap.clear();
-    m_appMap.clear();
+    {
+        std::lock_guard<std::shared_timed_mutex> lock(m_sessionsMutex);
+        m_sessionMap.clear();
+        m_appMap.clear();
+    }
+
+    // Stop watching the configuration file
+    if(m_configWatch) {
+        g_source_destroy(m_configWatch);
+        g_source_unref(m_configWatch);
+        m_configWatch = NULL;
+    }
+    if(m_configWatchFd != -1) {
+        close(m_configWatchFd);
+        m_configWatchFd = -1;
+    }
 
     // Clear Speaker Instance
     if(m_speaker) {
@@ -298,24 +553,8 @@ TTSManager::~TTSManager() {
         m_speaker = NULL;
     }
 
-    // Attempt to stop the MonitorClients thread
-    if(m_monitorClients && m_thread) {
-        m_monitorClients = false;
-        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-        if(fd>0) {
-            struct sockaddr_un addr;
-            memset(&addr, 0, sizeof(addr));
-
-            addr.sun_family = AF_UNIX;
-            strncpy(addr.sun_path, CLIENT_MONITOR_SOCKET_PATH, sizeof(addr.sun_path)-1);
-            connect(fd, (struct sockaddr*)&addr, sizeof(addr));
-            m_thread->join();
-            close(fd);
-
-            delete m_thread;
-            m_thread = NULL;
-        }
-    }
+    // Stop monitoring the clients
+    stopClientMonitor();
 }
 
 rtError TTSManager::enableTTS(bool enable) {
@@ -326,7 +565,7 @@ rtError TTSManager::enableTTS(bool enable) {
         TTSLOG_INFO("TTS is %s", enable ? "Enabled" : "Disabled");
 
         Event d("tts_state_changed");
-        d.set("enabled", m_ttsEnabled);
+        d.set("enabled", enable);
         sendEvent(d);
 
         if(m_ttsEnabled) {
@@ -361,12 +600,13 @@ rtError TTSManager::isTTSEnabled(bool &enabled) {
 }
 
 rtError TTSManager::listVoices(rtValue language, rtObjectRef &voices) {
+    TTSConfigurationPtr config = m_configuration.current();
     bool returnCurrentConfiguration = false;
     std::string key = std::string("voice_for_"); // return all voices
 
     if(language.isEmpty() || language.toString().isEmpty()) {
         returnCurrentConfiguration = true; // return voice for the configured language
-        key = m_defaultConfiguration.language();
+        key = config->language();
     } else if(language != "*") {
         key += language.toString().cString(); // return voices for only the passed language
     }
@@ -374,11 +614,11 @@ rtError TTSManager::listVoices(rtValue language, rtObjectRef &voices) {
     rtArrayObject *voicearray = new rtArrayObject;
     if(returnCurrentConfiguration) {
         TTSLOG_INFO("Retrieving voice configured for language=%s", key.c_str());
-        voicearray->pushBack(m_defaultConfiguration.voice());
+        voicearray->pushBack(config->voice());
     } else {
         TTSLOG_INFO("Retrieving voice list for language key=%s", key.c_str());
-        auto it = m_defaultConfiguration.m_others.begin();
-        while(it != m_defaultConfiguration.m_others.end()) {
+        auto it = config->languageVoices().begin();
+        while(it != config->languageVoices().end()) {
             if(it->first.find(key.c_str()) == 0)
                 voicearray->pushBack(rtString(it->second.c_str()));
             ++it;
@@ -389,22 +629,29 @@ rtError TTSManager::listVoices(rtValue language, rtObjectRef &voices) {
     return RT_OK;
 }
 
-bool fromString(TTSConfiguration &configuration, const std::string &str, const char delim) {
+// Empty fields are left unchanged
+bool fromString(TTSConfigurationUpdate &update, const std::string &str, const char delim) {
     auto tokens = split(str, delim);
     if(tokens.size() != 6)
         return false;
 
-    configuration.setEndPoint(tokens[0].c_str());
-    configuration.setSecureEndPoint(tokens[1].c_str());
-    configuration.setLanguage(tokens[2].c_str());
-    configuration.setVoice(tokens[3].c_str());
-    configuration.setVolume(tokens[4].empty() ? 100 : std::stod(tokens[4]));
-    configuration.setRate(tokens[5].empty() ? 50 : std::stoi(tokens[5]));
+    if(!tokens[0].empty())
+        update.setEndPoint(tokens[0].c_str());
+    if(!tokens[1].empty())
+        update.setSecureEndPoint(tokens[1].c_str());
+    if(!tokens[2].empty())
+        update.setLanguage(tokens[2].c_str());
+    if(!tokens[3].empty())
+        update.setVoice(tokens[3].c_str());
+    if(!tokens[4].empty())
+        update.setVolume(std::atof(tokens[4].c_str()));
+    if(!tokens[5].empty())
+        update.setRate(std::atoi(tokens[5].c_str()));
 
     return true;
 }
 
-std::string toString(TTSConfiguration &configuration, const char delim) {
+std::string toString(const TTSConfiguration &configuration, const char delim) {
     std::stringstream ss;
     ss <<
         configuration.endPoint() << delim <<
@@ -420,44 +667,16 @@ std::string toString(TTSConfiguration &configuration, const char delim) {
 rtError TTSManager::setConfiguration(rtString configuration) {
     TTSLOG_VERBOSE("Setting Default Configuration");
 
-    rtString v = m_defaultConfiguration.voice();
-
-    m_mutex.lock();
+    TTSConfigurationUpdate update;
     std::string configStr(configuration.cString());
-    if(!fromString(m_defaultConfiguration, configStr, ',')) {
+    if(!fromString(update, configStr, ',')) {
         TTSLOG_ERROR("Invalid configuration / parsing error with input \"%s\"", configStr.c_str());
         return RT_OK;
     }
 
-    if(m_defaultConfiguration.endPoint().isEmpty() && !m_defaultConfiguration.secureEndPoint().isEmpty())
-        m_defaultConfiguration.setEndPoint(m_defaultConfiguration.secureEndPoint());
-    else if(m_defaultConfiguration.secureEndPoint().isEmpty() && !m_defaultConfiguration.endPoint().isEmpty())
-        m_defaultConfiguration.setSecureEndPoint(m_defaultConfiguration.endPoint());
-    else if(m_defaultConfiguration.endPoint().isEmpty() && m_defaultConfiguration.secureEndPoint().isEmpty())
-        TTSLOG_WARNING("TTSEndPoint & SecureTTSEndPoints are empty!!!");
-
-    // Pass newly set configuration to all the sessions
-    // WARN : This might over write the session specific configurations (TBD)
-    ID_Session_Map::iterator it = m_sessionMap.begin();
-    while(it != m_sessionMap.end()) {
-        it->second->setConfiguration(m_defaultConfiguration);;
-        ++it;
-    }
-    m_mutex.unlock();
-
-    TTSLOG_INFO("Default config updated, endPoint=%s, secureEndPoint=%s, lang=%s, voice=%s, vol=%lf, rate=%u",
-            m_defaultConfiguration.endPoint().cString(),
-            m_defaultConfiguration.secureEndPoint().cString(),
-            m_defaultConfiguration.language().cString(),
-            m_defaultConfiguration.voice().cString(),
-            m_defaultConfiguration.volume(),
-            m_defaultConfiguration.rate());
-
-    if(v != m_defaultConfiguration.voice()) {
-        Event d("voice_changed");
-        d.set("voice", m_defaultConfiguration.voice());
-        sendEvent(d);
-    }
+    // Only the fields which changed are applied
+    if(!updateConfiguration(update))
+        TTSLOG_INFO("Default config is unchanged");
 
     return RT_OK;
 }
@@ -465,7 +684,7 @@ rtError TTSManager::setConfiguration(rtString configuration) {
 rtError TTSManager::getConfiguration(rtString &configuration) {
     TTSLOG_VERBOSE("Getting Default Configuration");
 
-    rtString rtConfigStr(toString(m_defaultConfiguration, ',').c_str());
+    rtString rtConfigStr(toString(*m_configuration.current(), ',').c_str());
     configuration = rtConfigStr;
     TTSLOG_INFO("Configuration string : %s", configuration.cString());
 
@@ -476,11 +695,117 @@ rtError TTSManager::isSessionActiveForApp(uint32_t appid, bool &active) {
     if(m_policy == RESERVATION) {
         active = (m_activeSession && m_activeSession->appId() == appid);
     } else {
+        std::shared_lock<std::shared_timed_mutex> lock(m_sessionsMutex);
         active = (m_appMap.find(appid) != m_appMap.end());
     }
     return RT_OK;
 }
 
+rtError TTSManager::getCacheStatistics(rtObjectRef &statistics) {
+    TTSAudioCache::Statistics stats = m_speaker->cacheStatistics();
+
+    statistics = new rtMapObject;
+    statistics.set("hits", stats.hits);
+    statistics.set("misses", stats.misses);
+    statistics.set("sharedFetches", stats.sharedFetches);
+    statistics.set("evictions", stats.evictions);
+    statistics.set("entries", stats.entries);
+    statistics.set("bytes", stats.bytes);
+    statistics.set("maxBytes", stats.maxBytes);
+
+    TTSClipStore::Statistics storeStats = m_speaker->clipStoreStatistics();
+    rtObjectRef clipStore = new rtMapObject;
+    clipStore.set("hits", storeStats.hits);
+    clipStore.set("misses", storeStats.misses);
+    clipStore.set("writes", storeStats.writes);
+    clipStore.set("evictions", storeStats.evictions);
+    clipStore.set("entries", storeStats.entries);
+    clipStore.set("bytes", storeStats.bytes);
+    clipStore.set("maxBytes", storeStats.maxBytes);
+    statistics.set("clipStore", clipStore);
+
+    return RT_OK;
+}
+
+rtError TTSManager::getStatistics(rtObjectRef &statistics) {
+    TTSStatistics &stats = m_speaker->statistics();
+
+    // Percentiles of time (ms) taken since enqueue to reach each stage
+    rtObjectRef stages = new rtMapObject;
+    for(int i = STAGE_DEQUEUED; i < STAGE_COUNT; ++i) {
+        TTSStatistics::Percentiles p = stats.percentiles((SpeechStage)i);
+        rtObjectRef stage = new rtMapObject;
+        stage.set("count", p.count);
+        stage.set("p50", p.p50);
+        stage.set("p95", p.p95);
+        stage.set("p99", p.p99);
+        stages.set(stageName((SpeechStage)i), stage);
+    }
+
+    // Recent speeches, latest first
+    std::vector<SpeechTimeline> timelines;
+    stats.timelines(timelines);
+    rtArrayObject *timelineArray = new rtArrayObject;
+    for(auto it = timelines.begin(); it != timelines.end(); ++it) {
+        rtObjectRef timeline = new rtMapObject;
+        timeline.set("id", it->id);
+        timeline.set("outcome", outcomeName(it->outcome));
+        timeline.set("priority", it->priority);
+        for(int i = STAGE_DEQUEUED; i < STAGE_COUNT; ++i)
+            timeline.set(stageName((SpeechStage)i), it->offset((SpeechStage)i));
+        timelineArray->pushBack(timeline);
+    }
+
+    // Time (ms) taken since enqueue to start playing, of every priority tier
+    rtArrayObject *tierArray = new rtArrayObject;
+    for(uint8_t i = 0; i < TTS_PRIORITY_TIERS; ++i) {
+        TTSStatistics::Percentiles p = stats.startPercentiles(i);
+        rtObjectRef tier = new rtMapObject;
+        tier.set("priority", i);
+        tier.set("count", p.count);
+        tier.set("p50", p.p50);
+        tier.set("p95", p.p95);
+        tier.set("p99", p.p99);
+        tier.set("preemptions", stats.preemptions(i));
+        tierArray->pushBack(tier);
+    }
+
+    // Event delivery of the manager (session = 0) & of every session
+    rtArrayObject *eventArray = new rtArrayObject;
+    auto addEventStatistics = [eventArray] (uint32_t sessionId, TTSEventSource::Statistics es) {
+        rtObjectRef events = new rtMapObject;
+        events.set("session", sessionId);
+        events.set("queued", es.queued);
+        events.set("delivered", es.delivered);
+        events.set("dropped", es.dropped);
+        events.set("late", es.late);
+        eventArray->pushBack(events);
+    };
+    addEventStatistics(0, eventStatistics());
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(m_sessionsMutex);
+        for(auto it = m_sessionMap.begin(); it != m_sessionMap.end(); ++it)
+            addEventStatistics(it->first, it->second->eventStatistics());
+    }
+
+    // rtRemote messages processed by the main loop wakeups
+    RtDispatchStatistics ds = rtRemoteDispatchStatistics();
+    rtObjectRef dispatch = new rtMapObject;
+    dispatch.set("wakeups", ds.wakeups);
+    dispatch.set("items", ds.items);
+    dispatch.set("maxItemsPerWakeup", ds.maxItems);
+    dispatch.set("budgetExceeded", ds.budgetExceeded);
+
+    statistics = new rtMapObject;
+    statistics.set("stages", stages);
+    statistics.set("tiers", rtObjectRef(tierArray));
+    statistics.set("timelines", rtObjectRef(timelineArray));
+    statistics.set("events", rtObjectRef(eventArray));
+    statistics.set("rtDispatch", dispatch);
+
+    return RT_OK;
+}
+
 rtError TTSManager::createSession(uint32_t appId, rtString appName, rtObjectRef eventCallbacks, rtObjectRef &sessionObject) {
     TTSSession *session = NULL;
 
@@ -489,15 +814,9 @@ rtError TTSManager::createSession(uint32_t appId, rtString appName, rtObjectRef
         sessionObject = new rtMapObject;
 
         // Check for duplicate App IDs / Sessions
-        ID_Session_Map::iterator it = m_sessionMap.begin();
-        while(it != m_sessionMap.end()) {
+        ID_Session_Map::iterator it = m_appMap.find(appId);
+        if(it != m_appMap.end()) {
             session = it->second;
-            if(session->appId() == appId)
-                break;
-            ++it;
-        }
-
-        if(it != m_sessionMap.end() && session) {
             TTSLOG_ERROR("Application \"%s\" already has a session \"%u\"", appName.cString(), session->sessionId());
             sessionObject.set("result", TTS_CREATE_SESSION_DUPLICATE);
             return RT_OK;
@@ -505,16 +824,19 @@ rtError TTSManager::createSession(uint32_t appId, rtString appName, rtObjectRef
 
         // Create a session
         uint32_t sessionId = nextSessionId();
-        session = new TTSSession(appId, appName, sessionId, m_defaultConfiguration);
+        session = new TTSSession(appId, appName, sessionId, m_configuration);
 
         // Update return values
         sessionObject.set("session", session);
         sessionObject.set("id", sessionId);
-        sessionObject.set("ttsEnabled", m_ttsEnabled);
+        sessionObject.set("ttsEnabled", m_ttsEnabled.load());
 
         // Update session map
-        m_appMap[appId] = session;
-        m_sessionMap[sessionId] = session;
+        {
+            std::lock_guard<std::shared_timed_mutex> slock(m_sessionsMutex);
+            m_appMap[appId] = session;
+            m_sessionMap[sessionId] = session;
+        }
         TTSLOG_INFO("New session \"%u\" created for app (%u, %s, %p)...",
                 sessionId, appId, appName.cString(), session);
 
@@ -563,33 +885,25 @@ rtError TTSManager::destroySession(uint32_t sessionId, rtValue &result) {
         releasePlayerResource(session->appId(), result, true);
     else
         session->setInactive(false);
+    m_speaker->forgetClient(session);
 
     // Remove from the map
-    m_sessionMap.erase(it);
-
-    ID_Session_Map::iterator ait = m_appMap.find(session->appId());
-    if(ait != m_appMap.end())
-        m_appMap.erase(ait);
-
-    TTSLOG_WARNING("Session \"%u\" with AppID \"%u\" is destroyed, map_size=%d", sessionId, session->appId(), m_sessionMap.size());
-
-    // Remove ConnectionMap Entry
-    EventSource *es = NULL;
-    ConnectionMap::iterator citr = m_connectionMap.begin();
-    while(citr != m_connectionMap.end()) {
-        es = (EventSource*)citr->second;
-        if(es->sessionId == sessionId) {
-            int fd = es->pfd.fd;
-            g_source_remove_poll((GSource*)es, &es->pfd);
-            g_source_destroy((GSource*)es);
-            g_source_unref((GSource*)es);
-            m_connectionMap.erase(citr);
-            close(fd);
-            break;
-        }
-        ++citr;
+    {
+        std::lock_guard<std::shared_timed_mutex> slock(m_sessionsMutex);
+        m_sessionMap.erase(it);
+
+        ID_Session_Map::iterator ait = m_appMap.find(session->appId());
+        if(ait != m_appMap.end() && ait->second == session)
+            m_appMap.erase(ait);
     }
 
+    TTSLOG_WARNING("Session \"%u\" with AppID \"%u\" is destroyed, map_size=%d", sessionId, session->appId(), (int)m_sessionMap.size());
+
+    // Stop monitoring the client's connection
+    auto citr = m_sessionConnection.find(sessionId);
+    if(citr != m_sessionConnection.end())
+        closeConnection(citr->second);
+
     if(m_sessionMap.size() == 0) {
         TTSLOG_WARNING("All sessions were destroyed, destroy pipeline");
         m_speaker->ensurePipeline(false);
@@ -600,12 +914,9 @@ rtError TTSManager::destroySession(uint32_t sessionId, rtValue &result) {
 
 void TTSManager::setResourceAllocationPolicy(ResourceAllocationPolicy policy) {
     if(m_policy != policy) {
-        if(policy == PRIORITY) {
-            TTSLOG_WARNING("Priority based resource allocation is not implemented now, falling back to Open policy");
-            policy = OPEN;
-        }
-
         m_policy = policy;
+        if(m_speaker)
+            m_speaker->setPriorityScheduling(policy == PRIORITY);
         TTSLOG_INFO("%s Policy is in effect", (policy == RESERVATION) ? "Reservation" : ((policy == OPEN) ? "Open" : "Priority"));
     }
 }
@@ -659,8 +970,9 @@ rtError TTSManager::reservePlayerResource(uint32_t appId, rtValue &result, bool
     }
 
     // Lock would be already held by claimPlayerResource()
+    std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
     if(!internalReq)
-        std::lock_guard<std::mutex> lock(m_mutex);
+        lock.lock();
 
     TTSLOG_INFO("Request to reserve the Player for %u, reservedApp=%u, claimedApp=%u, activeApp=%u",
             appId, m_reservedApp, m_claimedApp, m_activeSession ? m_activeSession->appId() : 0);
@@ -693,8 +1005,10 @@ rtError TTSManager::releasePlayerResource(uint32_t appId, rtValue &result, bool
         _return(TTS_OK);
     }
 
+    // Lock would be already held by claimPlayerResource() / destroySession()
+    std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
     if(!internalReq)
-        std::lock_guard<std::mutex> lock(m_mutex);
+        lock.lock();
 
     TTSLOG_INFO("Request to release the Player from %u, reservedApp=%u, claimedApp=%u, activeApp=%u",
             appId, m_reservedApp, m_claimedApp, m_activeSession ? m_activeSession->appId() : 0);
@@ -24,8 +24,9 @@
 #include "glib_utils.h"
 
 #include <map>
+#include <unordered_map>
 #include <mutex>
-#include <thread>
+#include <shared_mutex>
 #include <atomic>
 
 namespace TTS {
@@ -46,6 +47,8 @@ public:
     rtMethod1ArgAndNoReturn("setConfiguration", setConfiguration, rtString);
     rtMethodNoArgAndReturn("getConfiguration", getConfiguration, rtString);
     rtMethod1ArgAndReturn("isSessionActiveForApp", isSessionActiveForApp, uint32_t, bool);
+    rtMethodNoArgAndReturn("getCacheStatistics", getCacheStatistics, rtObjectRef);
+    rtMethodNoArgAndReturn("getStatistics", getStatistics, rtObjectRef);
 
     rtError enableTTS(bool enable);
     rtError isTTSEnabled(bool &enabled);
@@ -53,6 +56,8 @@ public:
     rtError setConfiguration(rtString configuration);
     rtError getConfiguration(rtString &configuration);
     rtError isSessionActiveForApp(uint32_t appid, bool &active);
+    rtError getCacheStatistics(rtObjectRef &statistics);
+    rtError getStatistics(rtObjectRef &statistics);
 
     // Resource management APIs
     rtMethodNoArgAndReturn("getResourceAllocationPolicy", getResourceAllocationPolicy, rtValue);
@@ -76,35 +81,50 @@ public:
     rtError destroySession(uint32_t sessionId, rtValue &result);
 
 private:
-    using ID_Session_Map=std::map<uint32_t, TTSSession*>;
+    // Sessions indexed by appId & sessionId, changed holding both m_mutex & m_sessionsMutex
+    // (in that order), so that they can be read holding either one of them
+    using ID_Session_Map=std::unordered_map<uint32_t, TTSSession*>;
     ID_Session_Map m_appMap;
     ID_Session_Map m_sessionMap;
+    mutable std::shared_timed_mutex m_sessionsMutex;
 
-    using ConnectionMap=std::map<int, EventSource*>;
-    ConnectionMap m_connectionMap;
+    // Connections of the clients, to tell when they go away (m_mutex)
+    std::unordered_map<int, uint32_t> m_connectionSession;  // fd -> session, 0 till the client sends it
+    std::unordered_map<uint32_t, int> m_sessionConnection;  // session -> fd
 
-    TTSConfiguration m_defaultConfiguration;
+    TTSConfigurationStore m_configuration;
     ResourceAllocationPolicy m_policy;
     uint32_t m_reservationForApp;
     uint32_t m_reservedApp;
     uint32_t m_claimedApp;
     TTSSession *m_activeSession;
     TTSSpeaker *m_speaker;
-    std::thread *m_thread;
-    bool m_monitorClients;
+    int m_monitorFd;
+    int m_monitorPollFd;
+    GSource *m_monitorSource;
     bool m_claimedSession;
-    bool m_ttsEnabled;
+    std::atomic<bool> m_ttsEnabled;
     std::mutex m_mutex;
 
-    TTSConfiguration& loadConfigurationsFromFile(rtString configFile);
+    bool loadConfigurationsFromFile(rtString configFile, bool reload=false);
+    uint32_t updateConfiguration(const TTSConfigurationUpdate &update);
     void setResourceAllocationPolicy(ResourceAllocationPolicy policy);
     void makeSessionActive(TTSSession *session);
     void makeSessionInActive(TTSSession *session);
     void makeReservedOrClaimedSessionActive();
 
-    static void MonitorClients(void *ctx);
+    // Listening socket & connections are polled by one epoll fd, a single source on the main loop
+    void startClientMonitor();
+    void stopClientMonitor();
+    void acceptClients();
+    uint32_t closeConnection(int fd);
     static void MonitorClientsSourceIOCB(void *source, void *ctx);
-    static void MonitorClientsSourceDestroyedCB(void *source, void *ctx);
+
+    // tts.ini is reloaded when it is written / replaced
+    int m_configWatchFd;
+    GSource *m_configWatch;
+    void watchConfigurationFile();
+    static void ConfigurationWatchIOCB(void *source, void *ctx);
 };
 
 } // namespace TTS
@@ -19,6 +19,7 @@
 
 #include "TTSSession.h"
 #include "TTSCommon.h"
+#include "TTSSpeechBatch.h"
 #include "logger.h"
 
 #include <sstream>
@@ -48,8 +49,10 @@ rtDefineProperty(TTSSession, isSpeaking);
 //Define TTSSession object methods
 rtDefineMethod(TTSSession, getConfiguration);
 rtDefineMethod(TTSSession, setPreemptiveSpeak);
+rtDefineMethod(TTSSession, setPriority);
 rtDefineMethod(TTSSession, getSpeechState);
 rtDefineMethod(TTSSession, speak);
+rtDefineMethod(TTSSession, speakBatch);
 rtDefineMethod(TTSSession, pause);
 rtDefineMethod(TTSSession, resume);
 rtDefineMethod(TTSSession, shut);
@@ -58,31 +61,50 @@ rtDefineMethod(TTSSession, requestExtendedEvents);
 
 // --- //
 
-TTSSession::TTSSession(uint32_t appId, rtString appName, uint32_t sessionId, TTSConfiguration configuration) :
-    m_speaker(NULL), m_havingConfigToUpdate(false), m_extendedEvents(0) {
+TTSSession::TTSSession(uint32_t appId, rtString appName, uint32_t sessionId, TTSConfigurationStore &configuration) :
+    m_speaker(NULL), m_configuration(configuration), m_preemptive(true), m_priority(0), m_extendedEvents(0) {
     m_appId = appId;
     m_name = appName;
     m_sessionId = sessionId;
-    m_configuration = configuration;
+
+    // Default priority of the app, used under Priority policy
+    auto it = TTSConfiguration::m_others.find(std::string("priority_for_") + appName.cString());
+    if(it != TTSConfiguration::m_others.end()) {
+        int priority = std::atoi(it->second.c_str());
+        if(priority >= 0 && priority <= TTS_MAX_PRIORITY)
+            m_priority = priority;
+        else
+            TTSLOG_WARNING("Invalid Priority input \"%d\"", priority);
+    }
 }
 
 TTSSession::~TTSSession() {
 }
 
 rtError TTSSession::setPreemptiveSpeak(bool preemptive, rtValue &result) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_configuration.setPreemptiveSpeak(preemptive);
+    m_preemptive = preemptive;
     TTSLOG_INFO("Preemptive Speech has been %s", preemptive ? "enabled" : "disabled");
     _return(TTS_OK);
 }
 
+rtError TTSSession::setPriority(uint32_t priority, rtValue &result) {
+    if(priority > TTS_MAX_PRIORITY) {
+        TTSLOG_ERROR("Invalid priority %u, should be within 0-%d", priority, TTS_MAX_PRIORITY);
+        _return(TTS_FAIL);
+    }
+
+    m_priority = priority;
+    TTSLOG_INFO("Speech priority is set to %u", priority);
+    _return(TTS_OK);
+}
+
 rtError TTSSession::getSpeechState(rtValue id, rtValue &result) {
     TTSLOG_TRACE("Speak");
 
     // Check if it is active session
     CHECK_ACTIVENESS();
 
-    _return(m_speaker->getSpeechState(this, id.toUInt32()));
+    _return(m_speaker->getSpeechState(this, id.toUInt32(), &m_speechStateQuery));
 }
 
 rtError TTSSession::speak(rtValue id, rtString text, bool secure, rtValue &result) {
@@ -91,7 +113,7 @@ rtError TTSSession::speak(rtValue id, rtString text, bool secure, rtValue &resul
     // Check if it is active session
     CHECK_ACTIVENESS();
 
-    if(!m_configuration.isValid()) {
+    if(!m_configuration.current()->isValid()) {
         TTSLOG_ERROR("Configuration is not set, can't speak");
         _return(TTS_INVALID_CONFIGURATION);
     }
@@ -101,6 +123,32 @@ rtError TTSSession::speak(rtValue id, rtString text, bool secure, rtValue &resul
     _return(TTS_OK);
 }
 
+rtError TTSSession::speakBatch(rtString batch, rtValue &result) {
+    TTSLOG_TRACE("SpeakBatch");
+
+    // Check if it is active session
+    CHECK_ACTIVENESS();
+
+    if(!m_configuration.current()->isValid()) {
+        TTSLOG_ERROR("Configuration is not set, can't speak");
+        _return(TTS_INVALID_CONFIGURATION);
+    }
+
+    std::vector<SpeechData> speeches;
+    bool valid = forEachSpeechRecord(batch.cString(), batch.byteLength(),
+        [this, &speeches] (uint32_t id, bool secure, const char *text, size_t length) {
+            speeches.emplace_back(this, id, rtString(text, (uint32_t)length), secure);
+        });
+    if(!valid) {
+        TTSLOG_ERROR("Malformed speech batch, nothing is spoken");
+        _return(TTS_FAIL);
+    }
+
+    m_speaker->speak(this, std::move(speeches));
+
+    _return(TTS_OK);
+}
+
 rtError TTSSession::pause(rtValue id, rtValue &result) {
     TTSLOG_TRACE("Pause");
 
@@ -134,7 +182,7 @@ rtError TTSSession::shut(rtValue &result) {
     CHECK_ACTIVENESS();
 
     if(m_speaker->isSpeaking(this)) {
-        m_speaker->cancelCurrentSpeech();
+        m_speaker->cancelCurrentSpeech(this);
     }
 
     _return(TTS_OK);
@@ -173,42 +221,17 @@ rtError TTSSession::sessionID(uint32_t &sessionid) const {
 rtError TTSSession::getConfiguration(rtObjectRef &configuration) {
     TTSLOG_TRACE("Getting configuration");
 
-    configuration.set("ttsEndPoint", m_configuration.endPoint());
-    configuration.set("ttsEndPointSecured", m_configuration.secureEndPoint());
-    configuration.set("language", m_configuration.language());
-    configuration.set("volume", m_configuration.volume());
-    configuration.set("voice", m_configuration.voice());
-    configuration.set("rate", m_configuration.rate());
+    TTSConfigurationPtr config = m_configuration.current();
+    configuration.set("ttsEndPoint", config->endPoint());
+    configuration.set("ttsEndPointSecured", config->secureEndPoint());
+    configuration.set("language", config->language());
+    configuration.set("volume", config->volume());
+    configuration.set("voice", config->voice());
+    configuration.set("rate", config->rate());
 
     return RT_OK;
 }
 
-void TTSSession::setConfiguration(TTSConfiguration &config) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    if(m_speaker && m_speaker->isSpeaking(this)) {
-        TTSLOG_WARNING("Session \"%u\" is speaking now, will update configuration once speaking is done", m_sessionId);
-        m_tmpConfiguration = config;
-        TTSLOG_INFO("tmpConfiguration, endPoint=%s, secureEndPoint=%s, lang=%s, voice=%s, vol=%lf, rate=%u",
-                m_tmpConfiguration.endPoint().cString(),
-                m_tmpConfiguration.secureEndPoint().cString(),
-                m_tmpConfiguration.language().cString(),
-                m_tmpConfiguration.voice().cString(),
-                m_tmpConfiguration.volume(),
-                m_tmpConfiguration.rate());
-        m_havingConfigToUpdate = true;
-    } else {
-        m_configuration.updateWith(config);
-        TTSLOG_INFO("configuration, endPoint=%s, secureEndPoint=%s, lang=%s, voice=%s, vol=%lf, rate=%u",
-                m_configuration.endPoint().cString(),
-                m_configuration.secureEndPoint().cString(),
-                m_configuration.language().cString(),
-                m_configuration.voice().cString(),
-                m_configuration.volume(),
-                m_configuration.rate());
-    }
-}
-
 void TTSSession::setActive(TTSSpeaker *speaker, bool notifyClient) {
     TTSLOG_TRACE("Activating Session");
 
@@ -242,11 +265,6 @@ void TTSSession::setInactive(bool notifyClient) {
     }
 }
 
-TTSConfiguration *TTSSession::configuration() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return &m_configuration;
-}
-
 void TTSSession::willSpeak(uint32_t speech_id, rtString text) {
     if(!(m_extendedEvents & EXT_EVENT_WILL_SPEAK))
         return;
@@ -271,11 +289,6 @@ void TTSSession::started(uint32_t speech_id, rtString text) {
 void TTSSession::spoke(uint32_t speech_id, rtString text) {
     TTSLOG_VERBOSE(" [%d, %s]", speech_id, text.cString());
 
-    if(m_havingConfigToUpdate) {
-        m_configuration.updateWith(m_tmpConfiguration);
-        m_havingConfigToUpdate = false;
-    }
-
     Event d("spoke");
     d.set("id", speech_id);
     d.set("text", text);
@@ -23,7 +23,7 @@
 #include "TTSEventSource.h"
 #include "TTSCommon.h"
 
-#include <mutex>
+#include <atomic>
 
 namespace TTS {
 
@@ -31,13 +31,15 @@ class TTSSession : public TTSEventSource, public TTSSpeakerClient {
 public:
     rtDeclareObject(TTSSession, TTSEventSource);
 
-    TTSSession(uint32_t appId, rtString appName, uint32_t sessionId, TTSConfiguration configuration);
+    TTSSession(uint32_t appId, rtString appName, uint32_t sessionId, TTSConfigurationStore &configuration);
     virtual ~TTSSession();
 
     // Declare object functions
     rtMethodNoArgAndReturn("getConfiguration", getConfiguration, rtObjectRef);
     rtMethod1ArgAndReturn("setPreemptiveSpeak", setPreemptiveSpeak, bool, rtValue);
+    rtMethod1ArgAndReturn("setPriority", setPriority, uint32_t, rtValue);
     rtMethod3ArgAndReturn("speak", speak, rtValue, rtString, bool, rtValue);
+    rtMethod1ArgAndReturn("speakBatch", speakBatch, rtString, rtValue);
     rtMethod1ArgAndReturn("pause", pause, rtValue, rtValue);
     rtMethod1ArgAndReturn("resume", resume, rtValue, rtValue);
     rtMethodNoArgAndReturn("shut", shut, rtValue);
@@ -47,8 +49,10 @@ public:
 
     rtError getConfiguration(rtObjectRef &configuration);
     rtError setPreemptiveSpeak(bool preemptive, rtValue &result);
+    rtError setPriority(uint32_t priority, rtValue &result);
     rtError getSpeechState(rtValue id, rtValue &result);
     rtError speak(rtValue id, rtString text, bool secure, rtValue &result);
+    rtError speakBatch(rtString batch, rtValue &result);
     rtError pause(rtValue id, rtValue &result);
     rtError resume(rtValue id, rtValue &result);
     rtError shut(rtValue &result);
@@ -65,7 +69,6 @@ public:
     rtError isSpeaking(rtValue &speaking) const;
 
     // Non-rt public functions
-    void setConfiguration(TTSConfiguration &config);
     void setActive(TTSSpeaker *speaker, bool notifyClient=true);
     void setInactive(bool notifyClient=true);
 
@@ -75,7 +78,8 @@ public:
 
 protected:
     // Speaker Client Callbacks
-    virtual TTSConfiguration *configuration();
+    virtual bool isPreemptive() { return m_preemptive; }
+    virtual uint8_t priority() { return m_priority; }
     virtual void willSpeak(uint32_t speech_id, rtString text);
     virtual void started(uint32_t speech_id, rtString text);
     virtual void spoke(uint32_t speech_id, rtString text);
@@ -87,12 +91,15 @@ protected:
     virtual void playbackerror(uint32_t speech_id);
 
     TTSSpeaker *m_speaker;
-    std::mutex m_mutex;
 
 private:
-    TTSConfiguration m_tmpConfiguration;
-    TTSConfiguration m_configuration;
-    bool m_havingConfigToUpdate;
+    // Shared with the manager, a speech uses the snapshot current when it starts
+    TTSConfigurationStore &m_configuration;
+    std::atomic<bool> m_preemptive;
+    std::atomic<uint8_t> m_priority;
+
+    // Polled speech's last pending lookup (rtRemote calls come on the main loop only)
+    SpeechStateQuery m_speechStateQuery;
 
     rtString m_name;
     uint32_t m_appId;
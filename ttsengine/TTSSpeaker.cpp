@@ -20,14 +20,57 @@
 #include "TTSSpeaker.h"
 #include "logger.h"
 
-#include <curl/curl.h>
 #include <unistd.h>
 #include <regex>
+#include <sstream>
+#include <algorithm>
 
 #define INT_FROM_ENV(env, default_value) ((getenv(env) ? atoi(getenv(env)) : 0) > 0 ? atoi(getenv(env)) : default_value)
 
+#define DEFAULT_AUDIO_CACHE_SIZE (2 * 1024 * 1024)
+#define AUDIO_FEED_TIMEOUT_MS (10 * 1000)
+#define DEFAULT_CLIP_STORE_DIRECTORY "/opt/tts/clips"
+#define DEFAULT_CLIP_STORE_SIZE (16 * 1024 * 1024)
+#define DEFAULT_CLIP_STORE_ENTRIES 1024
+#define DEFAULT_PREFETCH_DEPTH 2
+#define DEFAULT_MAX_SEGMENT_LENGTH 0
+#define MIN_SEGMENT_LENGTH 20
+#define DEFAULT_FETCH_WORKERS 4
+#define DEFAULT_STATISTICS_HISTORY 32
+#define DEFAULT_AUDIO_SINK "autoaudiosink"
+#define MAX_IDLE_STATE_ATTEMPTS 3
+
 namespace TTS {
 
+static long intFromConfig(const char *key, long defaultValue) {
+    auto it = TTSConfiguration::m_others.find(key);
+    if(it != TTSConfiguration::m_others.end() && !it->second.empty())
+        return std::atol(it->second.c_str());
+    return defaultValue;
+}
+
+static std::string stringFromConfig(const char *key, const char *defaultValue) {
+    auto it = TTSConfiguration::m_others.find(key);
+    if(it != TTSConfiguration::m_others.end())
+        return it->second;
+    return defaultValue;
+}
+
+// Segments are fed back to back as one stream, which plays only for headerless, frame
+// based audio. A container (WAV, MP4...) ends the stream after the first segment's header
+static uint32_t segmentLengthFromConfig() {
+    long length = intFromConfig("MaxSegmentLength", DEFAULT_MAX_SEGMENT_LENGTH);
+    if(length > 0 && stringFromConfig("EndpointAudioFormat", "") != "mp3") {
+        TTSLOG_WARNING("MaxSegmentLength needs an MP3 endpoint (EndpointAudioFormat=mp3), texts are not segmented");
+        return 0;
+    }
+    return length > 0 ? length : 0;
+}
+
+static void releaseAudioChunk(gpointer data) {
+    delete (AudioChunk*)data;
+}
+
 std::map<std::string, std::string> TTSConfiguration::m_others;
 
 TTSConfiguration::TTSConfiguration() :
@@ -35,83 +78,150 @@ TTSConfiguration::TTSConfiguration() :
     m_ttsEndPointSecured(""),
     m_language("en-US"),
     m_voice(""),
+    m_languageVoice(""),
     m_volume(MAX_VOLUME),
     m_rate(DEFAULT_RATE),
-    m_preemptiveSpeaking(true) { }
+    m_version(0) {
+    buildURLPrefixes();
+}
 
 TTSConfiguration::~TTSConfiguration() {}
 
-void TTSConfiguration::setEndPoint(const rtString endpoint) {
-    if(!endpoint.isEmpty())
-        m_ttsEndPoint = endpoint;
-    else
+bool TTSConfiguration::setEndPoint(const rtString &endpoint) {
+    if(endpoint.isEmpty()) {
         TTSLOG_WARNING("Invalid TTSEndPoint input \"%s\"", endpoint.cString());
+        return false;
+    }
+    if(m_ttsEndPoint == endpoint)
+        return false;
+    m_ttsEndPoint = endpoint;
+    return true;
 }
 
-void TTSConfiguration::setSecureEndPoint(const rtString endpoint) {
-    if(!endpoint.isEmpty())
-        m_ttsEndPointSecured = endpoint;
-    else
+bool TTSConfiguration::setSecureEndPoint(const rtString &endpoint) {
+    if(endpoint.isEmpty()) {
         TTSLOG_WARNING("Invalid Secured TTSEndPoint input \"%s\"", endpoint.cString());
+        return false;
+    }
+    if(m_ttsEndPointSecured == endpoint)
+        return false;
+    m_ttsEndPointSecured = endpoint;
+    return true;
 }
 
-void TTSConfiguration::setLanguage(const rtString language) {
-    if(!language.isEmpty())
-        m_language = language;
-    else
+bool TTSConfiguration::setLanguage(const rtString &language) {
+    if(language.isEmpty()) {
         TTSLOG_WARNING("Empty Language input");
+        return false;
+    }
+    if(m_language == language)
+        return false;
+    m_language = language;
+    return true;
 }
 
-void TTSConfiguration::setVoice(const rtString voice) {
-    if(!voice.isEmpty())
-        m_voice = voice;
-    else
+bool TTSConfiguration::setVoice(const rtString &voice) {
+    if(voice.isEmpty()) {
         TTSLOG_WARNING("Empty Voice input");
+        return false;
+    }
+    if(m_voice == voice)
+        return false;
+    m_voice = voice;
+    return true;
 }
 
-void TTSConfiguration::setVolume(const double volume) {
-    if(volume >= 1 && volume <= 100)
-        m_volume = volume;
-    else
+bool TTSConfiguration::setVolume(const double volume) {
+    if(volume < 1 || volume > 100) {
         TTSLOG_WARNING("Invalid Volume input \"%lf\"", volume);
+        return false;
+    }
+    if(m_volume == volume)
+        return false;
+    m_volume = volume;
+    return true;
 }
 
-void TTSConfiguration::setRate(const uint8_t rate) {
-    if(rate >= 1 && rate <= 100)
-        m_rate = rate;
-    else
+bool TTSConfiguration::setRate(const uint8_t rate) {
+    if(rate < 1 || rate > 100) {
         TTSLOG_WARNING("Invalid Rate input \"%u\"", rate);
+        return false;
+    }
+    if(m_rate == rate)
+        return false;
+    m_rate = rate;
+    return true;
 }
 
-void TTSConfiguration::setPreemptiveSpeak(const bool preemptive) {
-    m_preemptiveSpeaking = preemptive;
-}
+uint32_t TTSConfiguration::apply(const TTSConfigurationUpdate &update) {
+    uint32_t changed = 0;
+    uint32_t fields = update.fields();
+
+    if((fields & ENDPOINT) && setEndPoint(update.m_endPoint))
+        changed |= ENDPOINT;
+    if((fields & SECURE_ENDPOINT) && setSecureEndPoint(update.m_secureEndPoint))
+        changed |= SECURE_ENDPOINT;
+    if((fields & LANGUAGE) && setLanguage(update.m_language))
+        changed |= LANGUAGE;
+    if((fields & VOICE) && setVoice(update.m_voice))
+        changed |= VOICE;
+    if((fields & VOLUME) && setVolume(update.m_volume))
+        changed |= VOLUME;
+    if((fields & RATE) && setRate(update.m_rate))
+        changed |= RATE;
+    if((fields & LANGUAGE_VOICES) && m_languageVoices != update.m_languageVoices) {
+        m_languageVoices = update.m_languageVoices;
+        changed |= LANGUAGE_VOICES;
+    }
 
-const rtString &TTSConfiguration::voice() {
-    static rtString str;
+    // Either endpoint serves both, if only one is configured
+    if(m_ttsEndPoint.isEmpty() && !m_ttsEndPointSecured.isEmpty()) {
+        m_ttsEndPoint = m_ttsEndPointSecured;
+        changed |= ENDPOINT;
+    } else if(m_ttsEndPointSecured.isEmpty() && !m_ttsEndPoint.isEmpty()) {
+        m_ttsEndPointSecured = m_ttsEndPoint;
+        changed |= SECURE_ENDPOINT;
+    }
 
-    str = "";
-    if(!m_voice.isEmpty())
-        return m_voice;
-    else {
-        std::string key = std::string("voice_for_") + m_language.cString();
-        auto it = m_others.find(key);
-        if(it != m_others.end())
-            str = it->second.c_str();
-        return str;
+    if(changed & (LANGUAGE | LANGUAGE_VOICES)) {
+        auto it = m_languageVoices.find(std::string("voice_for_") + m_language.cString());
+        m_languageVoice = (it != m_languageVoices.end()) ? it->second.c_str() : "";
     }
+
+    if(changed)
+        buildURLPrefixes();
+
+    return changed;
 }
 
-void TTSConfiguration::updateWith(TTSConfiguration &nConfig) {
-    setEndPoint(nConfig.m_ttsEndPoint);
-    setSecureEndPoint(nConfig.m_ttsEndPointSecured);
-    setLanguage(nConfig.m_language);
-    setVoice(nConfig.m_voice);
-    setVolume(nConfig.m_volume);
-    setRate(nConfig.m_rate);
+void TTSConfiguration::buildURLPrefixes() {
+    std::string query;
+
+    // Voice
+    const rtString &v = voice();
+    if(!v.isEmpty()) {
+        query.append("voice=");
+        appendPercentEncoded(v.cString(), v.byteLength(), query);
+    }
+
+    // Language
+    if(!m_language.isEmpty()) {
+        query.append("&language=");
+        appendPercentEncoded(m_language.cString(), m_language.byteLength(), query);
+    }
+
+    // Rate / speed
+    query.append("&rate=");
+    query.append(std::to_string(m_rate > 100 ? 100 : m_rate));
+    query.append("&text=");
+
+    m_urlPrefix.assign(m_ttsEndPoint.cString());
+    m_urlPrefix.append(query);
+    m_secureUrlPrefix.assign(m_ttsEndPointSecured.cString());
+    m_secureUrlPrefix.append(query);
 }
 
-bool TTSConfiguration::isValid() {
+bool TTSConfiguration::isValid() const {
     if((m_ttsEndPoint.isEmpty() && m_ttsEndPointSecured.isEmpty())) {
         TTSLOG_ERROR("TTSEndPointEmpty=%d, TTSSecuredEndPointEmpty=%d",
                 m_ttsEndPoint.isEmpty(), m_ttsEndPointSecured.isEmpty());
@@ -120,29 +230,108 @@ bool TTSConfiguration::isValid() {
     return true;
 }
 
+uint32_t TTSConfigurationStore::update(const TTSConfigurationUpdate &update) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Snapshots in use stay untouched, only the new one is built
+    std::shared_ptr<TTSConfiguration> next = std::make_shared<TTSConfiguration>(*m_current);
+    uint32_t changed = next->apply(update);
+    if(changed) {
+        next->m_version = m_current->m_version + 1;
+        std::atomic_store(&m_current, TTSConfigurationPtr(next));
+        m_version.store(next->m_version, std::memory_order_release);
+    }
+    return changed;
+}
+
 // --- //
 
-TTSSpeaker::TTSSpeaker(TTSConfiguration &config) :
-    m_defaultConfig(config),
+#define STATE_SPEAKING      (1 << 8)
+#define STATE_HAS_SPEECH    (1 << 9)
+#define STATE_PAUSED        (1 << 10)
+
+void SpeakingStateSnapshot::publish(const TTSSpeakerClient *client, uint32_t speechId, bool speaking, bool hasSpeech, bool paused, uint8_t priority) {
+    uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_client.store(client, std::memory_order_relaxed);
+    m_speechId.store(speechId, std::memory_order_relaxed);
+    m_flags.store(priority | (speaking ? STATE_SPEAKING : 0) | (hasSpeech ? STATE_HAS_SPEECH : 0) | (paused ? STATE_PAUSED : 0),
+            std::memory_order_relaxed);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+SpeakingState SpeakingStateSnapshot::read() const {
+    SpeakingState state;
+    uint32_t flags;
+    uint32_t begin, end;
+    do {
+        begin = m_sequence.load(std::memory_order_acquire);
+        state.client = m_client.load(std::memory_order_relaxed);
+        state.speechId = m_speechId.load(std::memory_order_relaxed);
+        flags = m_flags.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        end = m_sequence.load(std::memory_order_relaxed);
+    } while((begin & 1) || begin != end);
+
+    state.speaking = (flags & STATE_SPEAKING);
+    state.hasSpeech = (flags & STATE_HAS_SPEECH);
+    state.paused = (flags & STATE_PAUSED);
+    state.priority = (flags & 0xFF);
+    state.queueGeneration = queueGeneration();
+    return state;
+}
+
+// --- //
+
+TTSSpeaker::TTSSpeaker(TTSConfigurationStore &config) :
+    m_configuration(config),
     m_clientSpeaking(NULL),
     m_currentSpeech(NULL),
     m_isSpeaking(false),
     m_isPaused(false),
+    m_speakingPriority(0),
+    m_priorityScheduling(false),
+    m_preempted(false),
+    m_resumePreempted(intFromConfig("ResumePreemptedSpeech", 0) != 0),
+    m_prefetchDepth(intFromConfig("PrefetchDepth", DEFAULT_PREFETCH_DEPTH)),
+    m_maxSegmentLength(segmentLengthFromConfig()),
+    m_prefetchPending(false),
+    m_statistics(intFromConfig("StatisticsHistory", DEFAULT_STATISTICS_HISTORY)),
+    m_audioCache(intFromConfig("AudioCacheSize", DEFAULT_AUDIO_CACHE_SIZE)),
+    m_clipStore(stringFromConfig("ClipStoreDirectory", DEFAULT_CLIP_STORE_DIRECTORY),
+            intFromConfig("ClipStoreSize", DEFAULT_CLIP_STORE_SIZE),
+            intFromConfig("ClipStoreEntries", DEFAULT_CLIP_STORE_ENTRIES)),
+    m_audioFetcher(m_audioCache, m_clipStore.isEnabled() ? &m_clipStore : NULL, intFromConfig("AudioFetchWorkers", DEFAULT_FETCH_WORKERS)),
     m_pipeline(NULL),
     m_source(NULL),
     m_audioSink(NULL),
+    m_volume(NULL),
     m_pipelineError(false),
     m_networkError(false),
     m_runThread(true),
     m_flushed(false),
     m_isEOS(false),
     m_ensurePipeline(false),
-    m_gstThread(new std::thread(GStreamerThreadFunc, this)),
+    m_gstThread(NULL),
     m_busWatch(0),
     m_duration(0),
     m_pipelineConstructionFailures(0),
-    m_maxPipelineConstructionFailures(INT_FROM_ENV("MAX_PIPELINE_FAILURE_THRESHOLD", 1)) {
+    m_maxPipelineConstructionFailures(INT_FROM_ENV("MAX_PIPELINE_FAILURE_THRESHOLD", 1)),
+    m_warmPipeline(INT_FROM_ENV("TTS_WARM_PIPELINE", intFromConfig("WarmPipeline", 0)) != 0),
+    m_firstAudioPending(false),
+    m_audioProgressed(false),
+    m_pipelineState(GST_STATE_NULL) {
         setenv("GST_DEBUG", "2", 0);
+        TTSConfigurationPtr current = config.current();
+        m_clipStore.setVersion(clipVersion(*current));
+        normalizerFor(current->language());
+        TTSLOG_INFO("Pipeline warm mode is %s", m_warmPipeline ? "enabled" : "disabled");
+
+        // Started last, the thread reads the members initialized above
+        m_gstThread = new std::thread(GStreamerThreadFunc, this);
 }
 
 TTSSpeaker::~TTSSpeaker() {
@@ -150,6 +339,7 @@ TTSSpeaker::~TTSSpeaker() {
         m_flushed = true;
     m_runThread = false;
     m_condition.notify_one();
+    interruptFeed();
 
     if(m_gstThread) {
         m_gstThread->join();
@@ -167,72 +357,204 @@ void TTSSpeaker::ensurePipeline(bool flag) {
 int TTSSpeaker::speak(TTSSpeakerClient *client, uint32_t id, rtString text, bool secure) {
     TTSLOG_TRACE("id=%d, text=\"%s\"", id, text.cString());
 
-    // If force speak is set, clear old queued data & stop speaking
-    if(client->configuration()->isPreemptive())
-        reset();
+    uint8_t priority = preparePriority(client);
 
-    SpeechData data(client, id, text, secure);
-    queueData(data);
+    SpeechData data(client, id, text, secure, priority);
+    data.timeline.mark(STAGE_ENQUEUED);
+    queueData(std::move(data));
+
+    if(m_priorityScheduling)
+        preemptLowerThan(priority);
 
     return 0;
 }
 
-SpeechState TTSSpeaker::getSpeechState(const TTSSpeakerClient *client, uint32_t id) {
-    // See if the speech is in progress i.e Speaking / Paused
+int TTSSpeaker::speak(TTSSpeakerClient *client, std::vector<SpeechData> &&speeches) {
+    TTSLOG_TRACE("Batch of %d speeches", (int)speeches.size());
+
+    if(speeches.empty())
+        return 0;
+
+    uint8_t priority = preparePriority(client);
+
+    for(auto &data : speeches) {
+        data.client = client;
+        data.priority = data.timeline.priority = priority;
+        data.timeline.mark(STAGE_ENQUEUED);
+    }
+    queueData(std::move(speeches));
+
+    if(m_priorityScheduling)
+        preemptLowerThan(priority);
+
+    return 0;
+}
+
+uint8_t TTSSpeaker::preparePriority(TTSSpeakerClient *client) {
+    uint8_t priority = m_priorityScheduling ? client->priority() : 0;
+
+    // If force speak is set, clear old queued data & stop speaking
+    // (only of the same priority, under priority scheduling)
+    if(client->isPreemptive()) {
+        if(m_priorityScheduling)
+            resetPriority(priority);
+        else
+            reset();
+    }
+
+    return priority;
+}
+
+void TTSSpeaker::setPriorityScheduling(bool enable) {
+    TTSLOG_INFO("Priority scheduling is %s (resume preempted speech=%d)", enable ? "enabled" : "disabled", m_resumePreempted);
+    m_priorityScheduling = enable;
+}
+
+void TTSSpeaker::preemptLowerThan(uint8_t priority) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    uint8_t preemptedPriority;
     {
-        std::lock_guard<std::mutex> lock(m_stateMutex);
-        if(client == m_clientSpeaking && m_currentSpeech && id == m_currentSpeech->id) {
-            if(m_isPaused)
-                return SPEECH_PAUSED;
-            else
-                return SPEECH_IN_PROGRESS;
-        }
+        std::lock_guard<std::mutex> stateLock(m_stateMutex);
+        if(!m_isSpeaking || m_flushed || m_speakingPriority >= priority)
+            return;
+        preemptedPriority = m_speakingPriority;
+        m_preempted = true;
+    }
+
+    TTSLOG_INFO("Preempting speech of priority %u for priority %u", preemptedPriority, priority);
+    m_statistics.preempted(preemptedPriority);
+    cancelSpeaking(NULL, true);
+}
+
+void TTSSpeaker::resetPriority(uint8_t priority) {
+    TTSLOG_VERBOSE("Resetting speeches of priority %u", priority);
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    bool speakingSamePriority = false;
+    {
+        std::lock_guard<std::mutex> stateLock(m_stateMutex);
+        speakingSamePriority = (m_isSpeaking && m_speakingPriority == priority);
     }
+    if(speakingSamePriority)
+        cancelSpeaking(NULL, false);
+
+    m_queue.clearPriority(priority, [this] (SpeechData &data) { dropPrefetched(data); });
+    m_state.queueChanged();
+}
+
+SpeechState TTSSpeaker::getSpeechState(const TTSSpeakerClient *client, uint32_t id, SpeechStateQuery *query) {
+    // See if the speech is in progress i.e Speaking / Paused
+    SpeakingState state = m_state.read();
+    if(state.client == client && state.hasSpeech && state.speechId == id)
+        return state.paused ? SPEECH_PAUSED : SPEECH_IN_PROGRESS;
 
-    // Or in queue
+    // Or in queue, the last answer holds till a speech enters / leaves the queue
+    if(query && query->valid && query->id == id && query->generation == state.queueGeneration)
+        return query->pending ? SPEECH_PENDING : SPEECH_NOT_FOUND;
+
+    bool pending;
+    uint64_t generation;
     {
         std::lock_guard<std::mutex> lock(m_queueMutex);
-        for(auto it = m_queue.begin(); it != m_queue.end(); ++it) {
-            if(it->id == id && it->client == client)
-                return SPEECH_PENDING;
-        }
+        pending = m_queue.contains(client, id);
+        generation = m_state.queueGeneration();
     }
 
-    return SPEECH_NOT_FOUND;
+    if(query) {
+        query->id = id;
+        query->generation = generation;
+        query->pending = pending;
+        query->valid = true;
+    }
+
+    return pending ? SPEECH_PENDING : SPEECH_NOT_FOUND;
 }
 
 void TTSSpeaker::clearAllSpeechesFrom(const TTSSpeakerClient *client, std::vector<uint32_t> &ids) {
     TTSLOG_VERBOSE("Cancelling all speeches");
     std::lock_guard<std::mutex> lock(m_queueMutex);
-    for(auto it = m_queue.begin(); it != m_queue.end();) {
-        if(it->client == client) {
-            ids.push_back(it->id);
-            it = m_queue.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    m_queue.removeClient(client, [this, &ids] (SpeechData &data) {
+            ids.push_back(data.id);
+            dropPrefetched(data);
+        });
+    m_state.queueChanged();
 
-    if(isSpeaking(client))
-        cancelCurrentSpeech();
+    cancelSpeaking(client, false);
 }
 
-bool TTSSpeaker::isSpeaking(const TTSSpeakerClient *client) {
-    std::lock_guard<std::mutex> lock(m_stateMutex);
+void TTSSpeaker::forgetClient(const TTSSpeakerClient *client) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_queue.forgetClient(client);
+}
+
+bool TTSSpeaker::isSpeaking(const TTSSpeakerClient *client) const {
+    SpeakingState state = m_state.read();
 
     if(client)
-        return (client == m_clientSpeaking);
+        return (client == state.client);
 
-    return m_isSpeaking;
+    return state.speaking;
 }
 
-void TTSSpeaker::cancelCurrentSpeech() {
+void TTSSpeaker::cancelCurrentSpeech(const TTSSpeakerClient *client) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    cancelSpeaking(client, false);
+}
+
+void TTSSpeaker::cancelSpeaking(const TTSSpeakerClient *client, bool resumable) {
     TTSLOG_VERBOSE("Cancelling current speech");
-    if(m_isSpeaking) {
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if(!m_isSpeaking || (client && client != m_clientSpeaking))
+            return;
+
+        // A speech cancelled by its client (or its tier) is dropped, even if it was preempted before
         m_isPaused = false;
+        if(!resumable)
+            m_preempted = false;
         m_flushed = true;
-        m_condition.notify_one();
+        publishState();
+    }
+    m_condition.notify_one();
+    interruptFeed();
+}
+
+void TTSSpeaker::configurationChanged() {
+    TTSLOG_INFO("Dropping the audio of the previous configuration");
+    m_audioCache.clear();
+    TTSConfigurationPtr config = m_configuration.current();
+    m_clipStore.setVersion(clipVersion(*config));
+
+    {
+        std::lock_guard<std::mutex> lock(m_normalizerMutex);
+        m_normalizer.reset();
+    }
+    normalizerFor(config->language());
+}
+
+std::shared_ptr<const TTSNormalizer> TTSSpeaker::normalizerFor(const rtString &language) {
+    std::lock_guard<std::mutex> lock(m_normalizerMutex);
+    if(m_normalizer && m_normalizerLanguage == language.cString())
+        return m_normalizer;
+
+    // Rules of the language, or the common rules, or the built-in English rules
+    std::string key = std::string("normalization_rules_for_") + language.cString();
+    std::string path = stringFromConfig(key.c_str(), "");
+    if(path.empty())
+        path = stringFromConfig("NormalizationRules", "");
+
+    std::shared_ptr<TTSNormalizer> normalizer = std::make_shared<TTSNormalizer>();
+    if(path.empty() || !normalizer->loadRules(path)) {
+        if(!path.empty())
+            TTSLOG_ERROR("Couldn't read normalization rules from \"%s\", using the defaults", path.c_str());
+        path = "built-in";
+        normalizer->addDefaultRules();
     }
+    normalizer->compile();
+    TTSLOG_INFO("Loaded %zu normalization rules (%s) for language \"%s\"", normalizer->rules(), path.c_str(), language.cString());
+
+    m_normalizer = normalizer;
+    m_normalizerLanguage = language.cString();
+    return m_normalizer;
 }
 
 bool TTSSpeaker::reset() {
@@ -249,7 +571,11 @@ void TTSSpeaker::pause(uint32_t id) {
 
     if(m_pipeline) {
         if(!m_isPaused) {
-            m_isPaused = true;
+            {
+                std::lock_guard<std::mutex> lock(m_stateMutex);
+                m_isPaused = true;
+                publishState();
+            }
             gst_element_set_state(m_pipeline, GST_STATE_PAUSED);
             TTSLOG_INFO("Set state to PAUSED");
         }
@@ -268,71 +594,205 @@ void TTSSpeaker::resume(uint32_t id) {
     }
 }
 
-void TTSSpeaker::setSpeakingState(bool state, TTSSpeakerClient *client) {
+void TTSSpeaker::setSpeakingState(bool state, TTSSpeakerClient *client, uint8_t priority) {
     std::lock_guard<std::mutex> lock(m_stateMutex);
 
     m_isSpeaking = state;
     m_clientSpeaking = client;
+    m_speakingPriority = priority;
+    if(state)
+        m_preempted = false;
     
     // If thread just completes speaking (called only from GStreamerThreadFunc),
     // it will take the next text from queue, no need to keep
     // m_flushed (as nothing is being spoken, which needs bail out)
     if(state == false)
         m_flushed = false;
+
+    publishState();
 }
 
-void TTSSpeaker::queueData(SpeechData data) {
+void TTSSpeaker::setCurrentSpeech(SpeechData *data) {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_currentSpeech = data;
+    publishState();
+}
+
+void TTSSpeaker::publishState() {
+    m_state.publish(m_clientSpeaking, m_currentSpeech ? m_currentSpeech->id : 0, m_isSpeaking,
+            m_currentSpeech != NULL, m_isPaused, m_speakingPriority);
+}
+
+void TTSSpeaker::queueData(SpeechData &&data) {
     std::lock_guard<std::mutex> lock(m_queueMutex);
-    m_queue.push_back(data);
+    m_queue.push(std::move(data));
+    m_state.queueChanged();
+    m_prefetchPending = true;
     m_condition.notify_one();
 }
 
-void TTSSpeaker::flushQueue() {
+void TTSSpeaker::queueData(std::vector<SpeechData> &&speeches) {
     std::lock_guard<std::mutex> lock(m_queueMutex);
-    m_queue.clear();
+    for(auto &data : speeches)
+        m_queue.push(std::move(data));
+    m_state.queueChanged();
+    m_prefetchPending = true;
+    m_condition.notify_one();
 }
 
-SpeechData TTSSpeaker::dequeueData() {
+void TTSSpeaker::flushQueue() {
     std::lock_guard<std::mutex> lock(m_queueMutex);
-    SpeechData d(m_queue.front());
-    m_queue.pop_front();
+    m_queue.clear([this] (SpeechData &data) { dropPrefetched(data); });
+    m_state.queueChanged();
+}
+
+TTSSpeechQueue::Entry *TTSSpeaker::dequeueData() {
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+
+    // Starts the fetch of the front item too, if it isn't prefetched already
+    prefetchQueued(lock);
+
+    // The queue may have been cleared while the prefetch was building the URLs
+    TTSSpeechQueue::Entry *entry = m_queue.pop();
+    if(!entry)
+        return NULL;
+    m_state.queueChanged();
     m_flushed = false;
-    return d;
+    entry->data.timeline.mark(STAGE_DEQUEUED);
+
+    prefetchQueued(lock);
+    return entry;
+}
+
+void TTSSpeaker::releaseData(TTSSpeechQueue::Entry *entry) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_queue.release(entry);
+}
+
+void TTSSpeaker::requeueData(TTSSpeechQueue::Entry *entry) {
+    m_queue.requeue(entry);
+    m_state.queueChanged();
+    m_prefetchPending = true;
+    m_condition.notify_one();
+}
+
+void TTSSpeaker::prefetchQueued(std::unique_lock<std::mutex> &lock) {
+    m_prefetchPending = false;
+
+    // Only the speeches to prefetch are picked under the lock, the URLs, the clip store
+    // lookups & the fetches are done without it, not to hold up speak() & the queries
+    std::vector<SpeechData> pending;
+    uint32_t count = 0;
+    m_queue.forEach([this, &count, &pending] (SpeechData &data) {
+        if(count++ >= m_prefetchDepth)
+            return false;
+        if(data.clips.empty())
+            pending.emplace_back(data.client, data.id, data.text, data.secure, data.priority);
+        return true;
+    });
+    if(pending.empty())
+        return;
+
+    // Prefetch is driven only from the GStreamer thread, constructURLs isn't thread safe
+    lock.unlock();
+    m_configuration.refresh(m_speakingConfig);
+    std::vector<std::string> &urls = m_urls;
+    for(auto &data : pending) {
+        if(constructURLs(*m_speakingConfig, data, urls)) {
+            TTSLOG_VERBOSE("Prefetching audio of speech %d (%zu segments)", data.id, urls.size());
+            for(auto uit = urls.begin(); uit != urls.end(); ++uit)
+                data.clips.push_back(fetchAudio(*uit));
+        }
+    }
+    lock.lock();
+
+    // The speeches may have been dequeued / cancelled meanwhile
+    for(auto &data : pending) {
+        SpeechData *queued = m_queue.find(data.client, data.id);
+        if(queued && queued->clips.empty())
+            queued->clips.swap(data.clips);
+        else
+            dropPrefetched(data);
+    }
+}
+
+void TTSSpeaker::dropPrefetched(SpeechData &data) {
+    std::lock_guard<std::mutex> lock(m_feedMutex);
+    for(auto cit = data.clips.begin(); cit != data.clips.end(); ++cit) {
+        const AudioClipPtr &clip = *cit;
+        if(clip->isComplete())
+            continue;
+
+        // The same clip may be shared by other queued speeches (same text) or being played out,
+        // prefetched speeches can be anywhere in the queue (a higher priority push / a requeue)
+        bool shared = (std::find(m_feedingClips.begin(), m_feedingClips.end(), clip) != m_feedingClips.end());
+        if(!shared) {
+            m_queue.forEach([&] (SpeechData &queued) {
+                if(&queued != &data)
+                    shared = (std::find(queued.clips.begin(), queued.clips.end(), clip) != queued.clips.end());
+                return !shared;
+            });
+        }
+
+        if(!shared) {
+            TTSLOG_VERBOSE("Cancelling prefetch of speech %d", data.id);
+            clip->cancel();
+        }
+    }
+    data.clips.clear();
+}
+
+bool TTSSpeaker::setPipelineState(GstState state, uint32_t timeout_ms) {
+    if(!m_pipeline)
+        return true;
+
+    GstStateChangeReturn ret = gst_element_set_state(m_pipeline, state);
+    if(ret == GST_STATE_CHANGE_FAILURE) {
+        TTSLOG_WARNING("Failed to set pipeline state to %s", gst_element_state_get_name(state));
+        return false;
+    }
+
+    // Only asynchronous changes need to wait for the bus
+    if(ret == GST_STATE_CHANGE_ASYNC)
+        return waitForStatus(state, timeout_ms);
+
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_pipelineState = state;
+    return true;
+}
+
+bool TTSSpeaker::pipelineIs(GstState state) {
+    GstState current = GST_STATE_VOID_PENDING, pending = GST_STATE_VOID_PENDING;
+    GstStateChangeReturn ret = gst_element_get_state(m_pipeline, &current, &pending, 0);
+    return ret == GST_STATE_CHANGE_SUCCESS && current == state && pending == GST_STATE_VOID_PENDING;
 }
 
 bool TTSSpeaker::waitForStatus(GstState expected_state, uint32_t timeout_ms) {
     // wait for the pipeline to get to pause so we know we have the audio device
     if(m_pipeline) {
-        GstState state;
-        GstState pending;
-
-        auto timeout = std::chrono::system_clock::now() + std::chrono::milliseconds(timeout_ms);
-
-        do {
-            std::unique_lock<std::mutex> mlock(m_queueMutex);
-            m_condition.wait_until(mlock, timeout, [this, &state, &pending, expected_state] () {
-                    // Speaker has flushed the data, no need wait for the completion
-                    // must break and reset the pipeline
-                    if(m_flushed) {
-                        TTSLOG_VERBOSE("Bailing out because of forced text queue (m_flushed=true)");
-                        return true;
-                    }
+        auto timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
 
-                    gst_element_get_state(m_pipeline, &state, &pending, GST_CLOCK_TIME_NONE);
-                    if(state == expected_state)
-                        return true;
+        std::unique_lock<std::mutex> mlock(m_queueMutex);
+        m_condition.wait_until(mlock, timeout, [this, expected_state] () {
+                // Speaker has flushed the data, no need wait for the completion
+                // must break and reset the pipeline
+                if(m_flushed) {
+                    TTSLOG_VERBOSE("Bailing out because of forced text queue (m_flushed=true)");
+                    return true;
+                }
 
-                    return false;
-                });
-        } while(!m_flushed && state != expected_state && timeout > std::chrono::system_clock::now());
+                // Updated by the bus, see handleMessage(). A message queued before the last
+                // state change may still be pending there, so the pipeline confirms the state
+                return m_pipelineState == expected_state && pipelineIs(expected_state);
+            });
 
-        if(state == expected_state) {
-            TTSLOG_VERBOSE("Got Status : expected_state = %d, new_state = %d", expected_state, state);
+        if(m_pipelineState == expected_state && pipelineIs(expected_state)) {
+            TTSLOG_VERBOSE("Got Status : expected_state = %d, new_state = %d", expected_state, m_pipelineState);
             return true;
         }
 
         TTSLOG_WARNING("Timed Out waiting for state %s, currentState %s",
-                gst_element_state_get_name(expected_state), gst_element_state_get_name(state));
+                gst_element_state_get_name(expected_state), gst_element_state_get_name(m_pipelineState));
         return false;
     }
 
@@ -428,6 +888,62 @@ static void onHaveType(GstElement *typefind, guint /*probability*/, GstCaps *src
         gst_object_unref (srcpad);
     }
 }
+#elif !defined(BCM_NEXUS)
+static void onPadAdded(GstElement */*decodebin*/, GstPad *pad, gpointer user_data)
+{
+    GstElement *convert = static_cast<GstElement*>(user_data);
+
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if(!caps)
+        caps = gst_pad_query_caps(pad, NULL);
+    bool isAudio = caps && strncmp(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "audio/", 6) == 0;
+    if(caps)
+        gst_caps_unref(caps);
+
+    if(!isAudio) {
+        TTSLOG_WARNING("Ignoring non audio pad of decodebin");
+        return;
+    }
+
+    // link decodebin to audioconvert to complete pipeline
+    GstPad *sinkpad = gst_element_get_static_pad(convert, "sink");
+    if(!gst_pad_is_linked(sinkpad)) {
+        bool linked = GST_PAD_LINK_SUCCESSFUL(gst_pad_link(pad, sinkpad));
+        if(!linked)
+            TTSLOG_WARNING("Failed to link decodebin and audioconvert");
+    }
+    gst_object_unref(sinkpad);
+}
+
+// Creates the sink from a "<factory> [property=value ...]" description,
+// ex: "alsasink device=hw:0", "fakesink sync=false"
+static GstElement *createAudioSink(const std::string &description)
+{
+    std::istringstream tokens(description);
+    std::string factory;
+    tokens >> factory;
+    if(factory.empty())
+        factory = DEFAULT_AUDIO_SINK;
+
+    GstElement *sink = gst_element_factory_make(factory.c_str(), NULL);
+    if(!sink) {
+        TTSLOG_ERROR("Couldn't create audio sink \"%s\"", factory.c_str());
+        return NULL;
+    }
+
+    std::string property;
+    while(tokens >> property) {
+        size_t pos = property.find('=');
+        if(pos == std::string::npos) {
+            TTSLOG_WARNING("Ignoring invalid audio sink property \"%s\"", property.c_str());
+            continue;
+        }
+        gst_util_set_object_arg(G_OBJECT(sink), property.substr(0, pos).c_str(), property.substr(pos + 1).c_str());
+    }
+
+    TTSLOG_INFO("Using audio sink \"%s\"", description.c_str());
+    return sink;
+}
 #endif
 
 // GStreamer Releated members
@@ -447,13 +963,16 @@ void TTSSpeaker::createPipeline() {
         return;
     }
 
-    m_source = gst_element_factory_make("souphttpsrc", NULL);
+    // Audio is fetched by TTSAudioFetcher / served from TTSAudioCache and pushed to appsrc
+    m_source = gst_element_factory_make("appsrc", NULL);
+    gst_app_src_set_stream_type(GST_APP_SRC(m_source), GST_APP_STREAM_TYPE_STREAM);
 
     // create soc specific elements
 #if defined(BCM_NEXUS)
     GstElement *decodebin = NULL;
     decodebin = gst_element_factory_make("brcmmp3decoder", NULL);
     m_audioSink = gst_element_factory_make("brcmpcmsink", NULL);
+    m_volume = m_audioSink;
 #elif defined(INTELCE)
     GstElement *typefind = NULL;
     GstElement *id3demux = NULL;
@@ -465,29 +984,32 @@ void TTSSpeaker::createPipeline() {
     // Need these properties so two gstreamer pipelines can play back audio at same time on ismd...
     g_object_set(G_OBJECT(m_audioSink), "sync", FALSE, NULL);
     g_object_set(G_OBJECT(m_audioSink), "audio-input-set-as-primary", FALSE, NULL);
-#endif
-
-    std::string tts_url =
-        !m_defaultConfig.secureEndPoint().isEmpty() ? m_defaultConfig.secureEndPoint().cString() : m_defaultConfig.endPoint().cString();
-    if(!tts_url.empty()) {
-        if(!m_defaultConfig.voice().isEmpty()) {
-            tts_url.append("voice=");
-            tts_url.append(m_defaultConfig.voice());
-        }
-
-        if(!m_defaultConfig.language().isEmpty()) {
-            tts_url.append("&language=");
-            tts_url.append(m_defaultConfig.language());
-        }
-
-        tts_url.append("&text=init");
-        curlSanitize(tts_url);
-
-        g_object_set(G_OBJECT(m_source), "location", tts_url.c_str(), NULL);
+    m_volume = m_audioSink;
+#else
+    // Generic backend, the sink is chosen by TTS_AUDIO_SINK env / AudioSink configuration
+    GstElement *decodebin = gst_element_factory_make("decodebin", NULL);
+    GstElement *convert = gst_element_factory_make("audioconvert", NULL);
+    GstElement *resample = gst_element_factory_make("audioresample", NULL);
+    m_volume = gst_element_factory_make("volume", NULL);
+    m_audioSink = createAudioSink(getenv("TTS_AUDIO_SINK") ? getenv("TTS_AUDIO_SINK") : stringFromConfig("AudioSink", DEFAULT_AUDIO_SINK));
+    if(!decodebin || !convert || !resample || !m_volume || !m_audioSink) {
+        TTSLOG_ERROR("Failed to create the generic pipeline elements");
+        if(decodebin) gst_object_unref(decodebin);
+        if(convert) gst_object_unref(convert);
+        if(resample) gst_object_unref(resample);
+        if(m_volume) gst_object_unref(m_volume);
+        if(m_audioSink) gst_object_unref(m_audioSink);
+        gst_object_unref(m_source);
+        gst_object_unref(m_pipeline);
+        m_pipeline = NULL;
+        m_source = m_volume = m_audioSink = NULL;
+        m_pipelineConstructionFailures++;
+        return;
     }
+#endif
 
     // set the TTS volume to max.
-    g_object_set(G_OBJECT(m_audioSink), "volume", (double) (m_defaultConfig.volume() / MAX_VOLUME), NULL);
+    g_object_set(G_OBJECT(m_volume), "volume", (double) (m_configuration.current()->volume() / MAX_VOLUME), NULL);
 
     // Add elements to pipeline and link
     bool result = TRUE;
@@ -501,6 +1023,12 @@ void TTSSpeaker::createPipeline() {
     result &= gst_element_link (parse, m_audioSink);
     // used to link rest of elements based on typefind results
     g_signal_connect (typefind, "have-type", G_CALLBACK (onHaveType), m_pipeline);
+#else
+    gst_bin_add_many(GST_BIN(m_pipeline), m_source, decodebin, convert, resample, m_volume, m_audioSink, NULL);
+    result &= gst_element_link (m_source, decodebin);
+    result &= gst_element_link_many (convert, resample, m_volume, m_audioSink, NULL);
+    // decodebin exposes its source pad once the stream type is known
+    g_signal_connect (decodebin, "pad-added", G_CALLBACK (onPadAdded), convert);
 #endif
 
     if(!result) {
@@ -516,7 +1044,14 @@ void TTSSpeaker::createPipeline() {
     gst_object_unref(bus);
     m_pipelineConstructionFailures = 0;
 
-    // wait until pipeline is set to NULL state
+    // Time to first audio is measured at the sink's input
+    GstPad *sinkPad = m_audioSink ? gst_element_get_static_pad(m_audioSink, "sink") : NULL;
+    if(sinkPad) {
+        gst_pad_add_probe(sinkPad, GST_PAD_PROBE_TYPE_BUFFER, AudioProgressProbe, this, NULL);
+        gst_object_unref(sinkPad);
+    }
+
+    // wait until pipeline is set to idle (NULL / READY) state
     resetPipeline();
 }
 
@@ -532,16 +1067,29 @@ void TTSSpeaker::resetPipeline() {
     }
     m_pipelineError = false;
     m_networkError = false;
-    m_isPaused = false;
     m_isEOS = false;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_isPaused = false;
+        publishState();
+    }
 
     if(!m_pipeline) {
         // If pipe line is NULL, create one
         createPipeline();
     } else {
-        // If pipeline is present, bring it to NULL state
-        gst_element_set_state(m_pipeline, GST_STATE_NULL);
-        while(!waitForStatus(GST_STATE_NULL, 60*1000));
+        // If pipeline is present, bring it to idle state. In warm mode the sink &
+        // decoder remain open in READY, only the source gets flushed
+        int attempts = 0;
+        while(!setPipelineState(idleState(), 60*1000) && ++attempts < MAX_IDLE_STATE_ATTEMPTS);
+
+        // A pipeline which doesn't settle is re-created, as on pipeline errors
+        if(attempts == MAX_IDLE_STATE_ATTEMPTS) {
+            TTSLOG_WARNING("Pipeline didn't reach %s, attempting to recover by re-creating pipeline",
+                    gst_element_state_get_name(idleState()));
+            destroyPipeline();
+            createPipeline();
+        }
     }
 }
 
@@ -549,14 +1097,17 @@ void TTSSpeaker::destroyPipeline() {
     TTSLOG_WARNING("Destroying Pipeline...");
 
     if(m_pipeline) {
-        gst_element_set_state(m_pipeline, GST_STATE_NULL);
-        waitForStatus(GST_STATE_NULL, 1*1000);
+        setPipelineState(GST_STATE_NULL, 1*1000);
         g_source_remove(m_busWatch);
         gst_object_unref(m_pipeline);
     }
 
     m_busWatch = 0;
     m_pipeline = NULL;
+    m_source = NULL;
+    m_audioSink = NULL;
+    m_volume = NULL;
+    m_pipelineState = GST_STATE_NULL;
     m_pipelineConstructionFailures = 0;
     m_condition.notify_one();
 }
@@ -564,195 +1115,285 @@ void TTSSpeaker::destroyPipeline() {
 void TTSSpeaker::waitForAudioToFinishTimeout(float timeout_s) {
     TTSLOG_TRACE("timeout_s=%f", timeout_s);
 
-    auto timeout = std::chrono::system_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
-    auto startTime = std::chrono::system_clock::now();
-    gint64 lastPosition = 0;
+    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
+    auto startTime = std::chrono::steady_clock::now();
+    gint64 duration = 0;
 
     auto playbackInterrupted = [this] () -> bool { return !m_pipeline || m_pipelineError || m_flushed; };
     auto playbackCompleted = [this] () -> bool { return m_isEOS; };
 
-    while(timeout > std::chrono::system_clock::now()) {
-        std::unique_lock<std::mutex> mlock(m_queueMutex);
+    // Woken up only by the bus (EOS / ERROR), the commands & the deadline, nothing is polled
+    m_audioProgressed = false;
+    std::unique_lock<std::mutex> mlock(m_queueMutex);
+    while(true) {
         m_condition.wait_until(mlock, timeout, [this, playbackInterrupted, playbackCompleted] () {
-            return playbackInterrupted() || playbackCompleted();
+            return playbackInterrupted() || playbackCompleted() || m_prefetchPending;
         });
 
+        // Speeches queued while this one is playing
+        if(m_prefetchPending) {
+            prefetchQueued(mlock);
+            continue;
+        }
+
         if(playbackInterrupted() || playbackCompleted()) {
             if(m_flushed)
                 TTSLOG_VERBOSE("Bailing out because of forced text queue (m_flushed=true)");
             break;
+        }
+
+        if(timeout > std::chrono::steady_clock::now())
+            continue;
+
+        // Deadline is hit, keep waiting only if the playback is paused / still moving
+        if(m_isPaused) {
+            timeout = std::chrono::steady_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
+        } else if((duration = m_duration) > 0 && duration != (gint64)GST_CLOCK_TIME_NONE &&
+            std::chrono::steady_clock::now() < startTime + std::chrono::nanoseconds(duration)) {
+            timeout = std::chrono::steady_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
+            TTSLOG_VERBOSE("Not reached duration");
+        } else if(m_audioProgressed.exchange(false)) {
+            // Audio reached the sink since the last deadline (see AudioProgressProbe)
+            timeout = std::chrono::steady_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
+            TTSLOG_VERBOSE("Audio is still progressing");
         } else {
-            if(m_isPaused) {
-                timeout = std::chrono::system_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
-            } else {
-                if(m_duration > 0 && m_duration != (gint64)GST_CLOCK_TIME_NONE &&
-                    std::chrono::system_clock::now() < startTime + std::chrono::nanoseconds(m_duration)) {
-                    timeout = std::chrono::system_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
-                    TTSLOG_VERBOSE("Not reached duration");
-                } else {
-                    // This is a workaround for broken BRCM PCM Sink duration query - To be deleted once that is fixed
-                    m_duration = 0;
-                    gint64 position = 0;
-                    gst_element_query_position(m_pipeline, GST_FORMAT_TIME, &position);
-                    if(position > 0 && position != (gint64)GST_CLOCK_TIME_NONE && position > lastPosition) {
-                        TTSLOG_VERBOSE("Reached/Invalid duration, last position=%" GST_TIME_FORMAT ", current position=%" GST_TIME_FORMAT,
-                                GST_TIME_ARGS(lastPosition), GST_TIME_ARGS(position));
-                        timeout = std::chrono::system_clock::now() + std::chrono::seconds((unsigned long)timeout_s);
-                        lastPosition = position;
-                    }
-                }
-            }
+            break;
         }
     }
+    mlock.unlock();
+
     TTSLOG_INFO("m_isEOS=%d, m_pipeline=%p, m_pipelineError=%d, m_flushed=%d",
             m_isEOS, m_pipeline, m_pipelineError, m_flushed);
 
     // Irrespective of EOS / Timeout reset pipeline
-    if(m_pipeline)
-        gst_element_set_state(m_pipeline, GST_STATE_NULL);
+    setPipelineState(idleState(), 1*1000);
 
     if(!m_isEOS)
         TTSLOG_ERROR("Stopped waiting for audio to finish without hitting EOS!");
     m_isEOS = false;
 }
 
-void TTSSpeaker::replaceIfIsolated(std::string& text, const std::string& search, const std::string& replace) {
-    size_t pos = 0;
-    while ((pos = text.find(search, pos)) != std::string::npos) {
-        bool punctBefore = (pos == 0 || std::ispunct(text[pos-1]) || std::isspace(text[pos-1]));
-        bool punctAfter = (pos+1 == text.length() || std::ispunct(text[pos+1]) || std::isspace(text[pos+1]));
-
-        if(punctBefore && punctAfter) {
-            text.replace(pos, search.length(), replace);
-            pos += replace.length();
-        } else {
-            pos += search.length();
-        }
-    }
+void TTSSpeaker::sanitizeString(const TTSNormalizer &normalizer, rtString &input, std::string &sanitizedString) {
+    normalizer.normalize(input.cString(), input.byteLength(), m_normalizedText);
+    sanitizeText(m_normalizedText.data(), m_normalizedText.size(), sanitizedString);
+    TTSLOG_VERBOSE("In:%s, Out:%s", input.cString(), sanitizedString.c_str());
 }
 
-bool TTSSpeaker::isSilentPunctuation(const char c) {
-    static std::string SilentPunctuation = "?!:;-()";
-    return (SilentPunctuation.find(c) != std::string::npos);
+bool TTSSpeaker::needsPipelineUpdate() {
+   return (m_pipelineConstructionFailures < m_maxPipelineConstructionFailures ? true : !m_queue.empty()) &&
+       ((m_ensurePipeline && !m_pipeline) || (m_pipeline && !m_ensurePipeline));
 }
 
-void TTSSpeaker::replaceSuccesivePunctuation(std::string& text) {
-    size_t pos = 0;
-    while(pos < text.length()) {
-        // Remove unwanted characters
-        static std::string stray = "\"";
-        if(stray.find(text[pos]) != std::string::npos) {
-            text.erase(pos,1);
-            if(++pos == text.length())
-                break;
+void TTSSpeaker::segmentText(const std::string &text, std::vector<TextRange> &segments) {
+    segments.clear();
+    auto cut = [&text, &segments] (size_t start, size_t end) {
+        while(start < end && isspace(text[start]))
+            ++start;
+        while(end > start && isspace(text[end - 1]))
+            --end;
+        if(end > start)
+            segments.emplace_back(start, end);
+    };
+
+    if(!m_maxSegmentLength) {
+        cut(0, text.length());
+        return;
+    }
+
+    // Split at every sentence end, long sentences are split further at clauses (or words)
+    size_t start = 0;
+    size_t lastClause = std::string::npos;
+    size_t lastSpace = std::string::npos;
+    for(size_t i = 0; i < text.length(); ++i) {
+        char c = text[i];
+        if(isspace(c)) {
+            lastSpace = i;
+        } else if(i + 1 == text.length() || isspace(text[i + 1])) {
+            if(c == '.' || c == '!' || c == '?') {
+                // Lower case continuation is most likely an abbreviation ("e.g. this")
+                size_t next = i + 1;
+                while(next < text.length() && isspace(text[next]))
+                    ++next;
+                if(i + 1 - start >= MIN_SEGMENT_LENGTH && (next == text.length() || !islower(text[next]))) {
+                    cut(start, i + 1);
+                    start = i + 1;
+                    lastClause = lastSpace = std::string::npos;
+                    continue;
+                }
+            } else if(c == ',' || c == ';' || c == ':') {
+                lastClause = i + 1;
+            }
         }
 
-        if(ispunct(text[pos])) {
-            ++pos;
-            while(pos < text.length() && (isSilentPunctuation(text[pos]) || isspace(text[pos]))) {
-                if(isSilentPunctuation(text[pos]))
-                    text.erase(pos,1);
-                else
-                    ++pos;
+        if(i + 1 - start > m_maxSegmentLength) {
+            size_t end = (lastClause != std::string::npos) ? lastClause : lastSpace;
+            if(end != std::string::npos && end > start) {
+                cut(start, end);
+                start = end;
+                lastClause = lastSpace = std::string::npos;
             }
-        } else {
-            ++pos;
         }
     }
+    cut(start, text.length());
 }
 
-void TTSSpeaker::curlSanitize(std::string &sanitizedString) {
-    CURL *curl = curl_easy_init();
-    if(curl) {
-      char *output = curl_easy_escape(curl, sanitizedString.c_str(), sanitizedString.size());
-      if(output) {
-          sanitizedString = output;
-          curl_free(output);
-      }
+bool TTSSpeaker::constructURLs(const TTSConfiguration &config, SpeechData &d, std::vector<std::string> &urls) {
+    if(!config.isValid()) {
+        TTSLOG_ERROR("Invalid configuration");
+        return false;
     }
-    curl_easy_cleanup(curl);
-}
-
-void TTSSpeaker::sanitizeString(rtString &input, std::string &sanitizedString) {
-    sanitizedString = input.cString();
-
-    replaceIfIsolated(sanitizedString, "$", "dollar");
-    replaceIfIsolated(sanitizedString, "#", "pound");
-    replaceIfIsolated(sanitizedString, "&", "and");
-    replaceIfIsolated(sanitizedString, "|", "bar");
-    replaceIfIsolated(sanitizedString, "/", "or");
-
-    replaceSuccesivePunctuation(sanitizedString);
-
-    curlSanitize(sanitizedString);
 
-    TTSLOG_VERBOSE("In:%s, Out:%s", input.cString(), sanitizedString.c_str());
+    // Sanitize String
+    sanitizeString(*normalizerFor(config.language()), d.text, m_sanitizedText);
+
+    // Every segment is synthesized separately, so that the first one can be
+    // played out while the endpoint is still working on the rest
+    segmentText(m_sanitizedText, m_segments);
+    if(m_segments.empty())
+        m_segments.emplace_back(0, m_sanitizedText.size());
+
+    // Endpoint, voice, language & rate are in the prefix built with the configuration,
+    // the URL strings (& the vector) of the previous call are overwritten in place
+    const std::string &prefix = config.urlPrefix(d.secure);
+    urls.resize(m_segments.size());
+    for(size_t i = 0; i < m_segments.size(); ++i) {
+        const TextRange &segment = m_segments[i];
+        urls[i].assign(prefix);
+        appendPercentEncoded(m_sanitizedText.data() + segment.first, segment.second - segment.first, urls[i]);
+        TTSLOG_VERBOSE("Constructured final URL is %s", urls[i].c_str());
+    }
+    return true;
 }
 
-bool TTSSpeaker::needsPipelineUpdate() {
-   return (m_pipelineConstructionFailures < m_maxPipelineConstructionFailures ? true : !m_queue.empty()) &&
-       ((m_ensurePipeline && !m_pipeline) || (m_pipeline && !m_ensurePipeline));
+uint64_t TTSSpeaker::clipVersion(const TTSConfiguration &config) {
+    uint64_t version = TTSClipStore::hash(NULL, 0);
+    const rtString fields[] = { config.endPoint(), config.secureEndPoint(), config.voice(), config.language() };
+    for(const rtString &field : fields)
+        version = TTSClipStore::hash(field.cString(), field.byteLength() + 1, version);
+    return version;
 }
 
-std::string TTSSpeaker::constructURL(TTSConfiguration &config, SpeechData &d) {
-    if(!config.isValid()) {
-        TTSLOG_ERROR("Invalid configuration");
-        return "";
-    }
+AudioClipPtr TTSSpeaker::fetchAudio(const std::string &url) {
+    bool created = false;
+    AudioClipPtr clip = m_audioCache.acquire(url, created);
+
+    if(created) {
+        // Audio of the previous runs is mapped directly from the clip store
+        AudioChunk chunk;
+        if(m_clipStore.lookup(url, chunk)) {
+            TTSLOG_INFO("Audio is served from clip store");
+            clip->append(chunk);
+            clip->complete(true);
+            m_audioCache.commit(clip);
+        } else {
+            m_audioFetcher.fetch(clip);
+        }
+    } else
+        TTSLOG_INFO("Audio is served from cache (complete=%d)", clip->isComplete());
 
-    // EndPoint URL
-    std::string tts_request;
-    if(d.secure)
-        tts_request.append(config.secureEndPoint());
-    else
-        tts_request.append(config.endPoint());
+    return clip;
+}
 
-    // Voice
-    if(!config.voice().isEmpty()) {
-        tts_request.append("voice=");
-        tts_request.append(config.voice().cString());
+bool TTSSpeaker::feedAudio(const std::vector<AudioClipPtr> &clips) {
+    {
+        std::lock_guard<std::mutex> lock(m_feedMutex);
+        m_feedingClips = clips;
     }
 
-    // Language
-    if(!config.language().isEmpty()) {
-        tts_request.append("&language=");
-        tts_request.append(config.language());
+    auto feedInterrupted = [this] () -> bool { return !m_pipeline || m_pipelineError || m_flushed; };
+
+    // Segments are pushed back to back as a single stream, EOS only after the last one
+    bool fed = false;
+    size_t index = 0;
+    size_t segment = 0;
+    AudioChunk chunk;
+    while(segment < clips.size()) {
+        const AudioClipPtr &clip = clips[segment];
+        AudioClip::ReadStatus status = clip->read(index, chunk, feedInterrupted, AUDIO_FEED_TIMEOUT_MS);
+
+        if(status == AudioClip::CHUNK_AVAILABLE) {
+            if(m_currentSpeech)
+                m_currentSpeech->timeline.markOnce(STAGE_FIRST_BYTE);
+
+            // Wrap the chunk without copying, GStreamer releases the reference once done
+            GstBuffer *buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+                    (gpointer)chunk.data, chunk.size, 0, chunk.size, new AudioChunk(chunk), releaseAudioChunk);
+            GstFlowReturn ret = gst_app_src_push_buffer(GST_APP_SRC(m_source), buffer);
+            if(ret != GST_FLOW_OK) {
+                TTSLOG_WARNING("Pushing audio to pipeline failed, flow=%d", ret);
+                break;
+            }
+            ++index;
+        } else if(status == AudioClip::END_OF_CLIP) {
+            index = 0;
+            if(++segment == clips.size()) {
+                gst_app_src_end_of_stream(GST_APP_SRC(m_source));
+                fed = true;
+            }
+        } else if(status == AudioClip::CLIP_FAILED || status == AudioClip::READ_TIMEDOUT) {
+            TTSLOG_ERROR("Couldn't get audio from TTS endpoint (%s)", status == AudioClip::CLIP_FAILED ? "failed" : "timed out");
+            m_networkError = true;
+            break;
+        } else {
+            TTSLOG_VERBOSE("Bailing out of audio feed (m_pipelineError=%d, m_flushed=%d)", m_pipelineError, m_flushed);
+            break;
+        }
     }
 
-    // Rate / speed
-    tts_request.append("&rate=");
-    tts_request.append(std::to_string(config.rate() > 100 ? 100 : config.rate()));
-
-    // Sanitize String
-    std::string sanitizedString;
-    sanitizeString(d.text, sanitizedString);
+    {
+        std::lock_guard<std::mutex> lock(m_feedMutex);
+        m_feedingClips.clear();
+    }
 
-    tts_request.append("&text=");
-    tts_request.append(sanitizedString);
+    return fed;
+}
 
-    TTSLOG_WARNING("Constructured final URL is %s", tts_request.c_str());
-    return tts_request;
+void TTSSpeaker::interruptFeed() {
+    std::lock_guard<std::mutex> lock(m_feedMutex);
+    for(auto it = m_feedingClips.begin(); it != m_feedingClips.end(); ++it)
+        (*it)->wakeup();
 }
 
-void TTSSpeaker::speakText(TTSConfiguration config, SpeechData &data) {
+void TTSSpeaker::speakText(const TTSConfiguration &config, SpeechData &data) {
     m_isEOS = false;
     m_duration = 0;
+    m_speakStartTime = std::chrono::steady_clock::now();
+    m_firstAudioPending = true;
 
     if(m_pipeline && !m_pipelineError && !m_flushed) {
-        m_currentSpeech = &data;
+        setCurrentSpeech(&data);
 
-        g_object_set(G_OBJECT(m_source), "location", constructURL(config, data).c_str(), NULL);
-        // PCM Sink seems to be accepting volume change before PLAYING state
-        g_object_set(G_OBJECT(m_audioSink), "volume", (double) (data.client->configuration()->volume() / MAX_VOLUME), NULL);
-        gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
-        TTSLOG_VERBOSE("Speaking.... (%d, \"%s\")", data.id, data.text.cString());
+        // Only used before the feed, the prefetch while waiting for the EOS reuses m_urls
+        std::vector<std::string> &urls = m_urls;
+        if(!constructURLs(config, data, urls)) {
+            m_networkError = true;
+        } else {
+            data.timeline.mark(STAGE_URL_BUILT);
+
+            // Prefetched clips are good only if the configuration didn't change meanwhile
+            std::vector<AudioClipPtr> clips;
+            clips.swap(data.clips);
+            if(clips.size() != urls.size())
+                clips.assign(urls.size(), AudioClipPtr());
+            for(size_t i = 0; i < urls.size(); ++i) {
+                if(!clips[i] || clips[i]->key() != urls[i] || clips[i]->isCancelled() || clips[i]->isFailed())
+                    clips[i] = fetchAudio(urls[i]);
+            }
 
-        //Wait for EOS with a timeout incase EOS never comes
-        waitForAudioToFinishTimeout(10);
+            // PCM Sink seems to be accepting volume change before PLAYING state
+            g_object_set(G_OBJECT(m_volume), "volume", (double) (config.volume() / MAX_VOLUME), NULL);
+            gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
+            TTSLOG_VERBOSE("Speaking.... (%d, \"%s\")", data.id, data.text.cString());
+
+            //Wait for EOS with a timeout incase EOS never comes
+            if(feedAudio(clips))
+                waitForAudioToFinishTimeout(10);
+        }
     } else {
         TTSLOG_WARNING("m_pipeline=%p, m_pipelineError=%d", m_pipeline, m_pipelineError);
     }
-    m_currentSpeech = NULL;
+    m_firstAudioPending = false;
+    setCurrentSpeech(NULL);
 }
 
 void TTSSpeaker::GStreamerThreadFunc(void *ctx) {
@@ -767,9 +1408,13 @@ void TTSSpeaker::GStreamerThreadFunc(void *ctx) {
 
                 // If pipeline creation fails, send playbackerror to the client and remove the req from queue
                 if(!speaker->m_pipeline && !speaker->m_queue.empty()) {
-                    SpeechData data = speaker->dequeueData();
-                    TTSLOG_ERROR("Pipeline creation failed, sending error for speech=%d from client %p\n", data.id, data.client);
-                    data.client->playbackerror(data.id);
+                    TTSSpeechQueue::Entry *entry = speaker->dequeueData();
+                    if(entry) {
+                        SpeechData &data = entry->data;
+                        TTSLOG_ERROR("Pipeline creation failed, sending error for speech=%d from client %p\n", data.id, data.client);
+                        data.client->playbackerror(data.id);
+                        speaker->releaseData(entry);
+                    }
                     speaker->m_pipelineConstructionFailures = 0;
                 }
             } else {
@@ -789,8 +1434,7 @@ void TTSSpeaker::GStreamerThreadFunc(void *ctx) {
         // Stop thread on Speaker's cue
         if(!speaker->m_runThread) {
             if(speaker->m_pipeline) {
-                gst_element_set_state(speaker->m_pipeline, GST_STATE_NULL);
-                speaker->waitForStatus(GST_STATE_NULL, 1*1000);
+                speaker->setPipelineState(GST_STATE_NULL, 1*1000);
             }
             TTSLOG_INFO("Stopping GStreamerThread");
             return;
@@ -801,28 +1445,55 @@ void TTSSpeaker::GStreamerThreadFunc(void *ctx) {
         }
 
         TTSLOG_INFO("Got text input, list size=%d", speaker->m_queue.size());
-        SpeechData data = speaker->dequeueData();
+        TTSSpeechQueue::Entry *entry = speaker->dequeueData();
+        if(!entry)
+            continue;
+        SpeechData &data = entry->data;
 
-        speaker->setSpeakingState(true, data.client);
+        speaker->setSpeakingState(true, data.client, data.priority);
         // Inform the client before speaking
         if(!speaker->m_flushed)
             data.client->willSpeak(data.id, data.text);
 
         // Push it to gstreamer for speaking
         if(!speaker->m_flushed) {
-            speaker->speakText(*data.client->configuration(), data);
+            speaker->m_configuration.refresh(speaker->m_speakingConfig);
+            speaker->speakText(*speaker->m_speakingConfig, data);
         }
 
-        // Inform the client after speaking
-        if(speaker->m_flushed)
-            data.client->interrupted(data.id);
-        else if(speaker->m_networkError)
-            data.client->networkerror(data.id);
-        else if(!speaker->m_pipeline || speaker->m_pipelineError)
-            data.client->playbackerror(data.id);
-        else
-            data.client->spoke(data.id, data.text);
+        // A preempted speech is spoken again later if configured. It is put back while still
+        // speaking, so that a cancel of its client either drops the suspension or finds it queued
+        bool suspended = false;
+        {
+            std::lock_guard<std::mutex> lock(speaker->m_queueMutex);
+            if(speaker->m_flushed && speaker->m_preempted && speaker->m_resumePreempted) {
+                TTSLOG_INFO("Speech %d of priority %u is suspended", data.id, data.priority);
+                speaker->requeueData(entry);
+                suspended = true;
+            }
+        }
+
+        // Inform the client after speaking (the entry of a suspended speech belongs to the queue again)
+        if(!suspended) {
+            if(speaker->m_flushed) {
+                data.client->interrupted(data.id);
+                data.timeline.outcome = OUTCOME_INTERRUPTED;
+            } else if(speaker->m_networkError) {
+                data.client->networkerror(data.id);
+                data.timeline.outcome = OUTCOME_NETWORK_ERROR;
+            } else if(!speaker->m_pipeline || speaker->m_pipelineError) {
+                data.client->playbackerror(data.id);
+                data.timeline.outcome = OUTCOME_PLAYBACK_ERROR;
+            } else {
+                data.client->spoke(data.id, data.text);
+                data.timeline.outcome = OUTCOME_SPOKE;
+                data.timeline.mark(STAGE_SPOKE);
+            }
+            speaker->m_statistics.record(data.timeline);
+        }
         speaker->setSpeakingState(false);
+        if(!suspended)
+            speaker->releaseData(entry);
 
         // stop the pipeline until the next tts string...
         speaker->resetPipeline();
@@ -831,6 +1502,20 @@ void TTSSpeaker::GStreamerThreadFunc(void *ctx) {
     speaker->destroyPipeline();
 }
 
+GstPadProbeReturn TTSSpeaker::AudioProgressProbe(GstPad *, GstPadProbeInfo *, gpointer data) {
+    TTSSpeaker *speaker = (TTSSpeaker*)data;
+    speaker->m_audioProgressed = true;
+
+    bool pending = true;
+    if(speaker->m_firstAudioPending.compare_exchange_strong(pending, false)) {
+        auto elapsed = std::chrono::steady_clock::now() - speaker->m_speakStartTime;
+        TTSLOG_INFO("Time to first audio %lld ms (warm pipeline=%d)",
+                (long long)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), speaker->m_warmPipeline);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
 int TTSSpeaker::GstBusCallback(GstBus *, GstMessage *message, gpointer data) {
     TTSSpeaker *speaker = (TTSSpeaker*)data;
     return speaker->handleMessage(message);
@@ -850,11 +1535,12 @@ bool TTSSpeaker::handleMessage(GstMessage *message) {
                 gst_message_parse_error(message, &error, &debug);
                 TTSLOG_ERROR("error! code: %d, %s, Debug: %s", error->code, error->message, debug);
                 GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(m_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "error-pipeline");
-                std::string source = GST_MESSAGE_SRC_NAME(message);
-                if(source.find("souphttpsrc") == 0)
-                    m_networkError = true;
-                m_pipelineError = true;
+                {
+                    std::lock_guard<std::mutex> lock(m_queueMutex);
+                    m_pipelineError = true;
+                }
                 m_condition.notify_one();
+                interruptFeed();
             }
             break;
 
@@ -866,15 +1552,25 @@ bool TTSSpeaker::handleMessage(GstMessage *message) {
 
         case GST_MESSAGE_EOS: {
                 TTSLOG_INFO("Audio EOS message received");
-                m_isEOS = true;
+                {
+                    std::lock_guard<std::mutex> lock(m_stateMutex);
+                    if(m_currentSpeech)
+                        m_currentSpeech->timeline.markOnce(STAGE_EOS);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_queueMutex);
+                    m_isEOS = true;
+                }
                 m_condition.notify_one();
             }
             break;
 
 
         case GST_MESSAGE_DURATION_CHANGED: {
-                gst_element_query_duration(m_pipeline, GST_FORMAT_TIME, &m_duration);
-                TTSLOG_INFO("Duration %" GST_TIME_FORMAT, GST_TIME_ARGS(m_duration));
+                gint64 duration = 0;
+                gst_element_query_duration(m_pipeline, GST_FORMAT_TIME, &duration);
+                m_duration = duration;
+                TTSLOG_INFO("Duration %" GST_TIME_FORMAT, GST_TIME_ARGS(duration));
             }
             break;
 
@@ -896,9 +1592,21 @@ bool TTSSpeaker::handleMessage(GstMessage *message) {
                         GST_MESSAGE_SRC_NAME(message) ? GST_MESSAGE_SRC_NAME(message) : "",
                         gst_element_state_get_name (oldstate), gst_element_state_get_name (newstate), gst_element_state_get_name (pending));
 
+                // Settled state, wakes up the waitForStatus()
+                if (pending == GST_STATE_VOID_PENDING) {
+                    {
+                        std::lock_guard<std::mutex> lock(m_queueMutex);
+                        m_pipelineState = newstate;
+                    }
+                    m_condition.notify_one();
+                }
+
                 if (oldstate == GST_STATE_NULL && newstate == GST_STATE_READY) {
                 } else if (oldstate == GST_STATE_READY && newstate == GST_STATE_PAUSED) {
                     GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(m_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "paused-pipeline");
+                    std::lock_guard<std::mutex> lock(m_stateMutex);
+                    if(m_currentSpeech)
+                        m_currentSpeech->timeline.markOnce(STAGE_PAUSED);
                 } else if (oldstate == GST_STATE_PAUSED && newstate == GST_STATE_PAUSED) {
                 } else if (oldstate == GST_STATE_PAUSED && newstate == GST_STATE_PLAYING) {
                     GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(m_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "playing-pipeline");
@@ -906,9 +1614,11 @@ bool TTSSpeaker::handleMessage(GstMessage *message) {
                     if(m_clientSpeaking) {
                         if(m_isPaused) {
                             m_isPaused = false;
+                            publishState();
                             m_clientSpeaking->resumed(m_currentSpeech->id);
                             m_condition.notify_one();
                         } else {
+                            m_currentSpeech->timeline.markOnce(STAGE_PLAYING);
                             m_clientSpeaking->started(m_currentSpeech->id, m_currentSpeech->text);
                         }
                     }
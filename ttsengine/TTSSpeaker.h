@@ -22,14 +22,24 @@
 #include <rtRemote.h>
 #include <gst/audio/audio.h>
 #include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
 
 #include <map>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <condition_variable>
 
 #include "TTSCommon.h"
+#include "TTSAudioCache.h"
+#include "TTSAudioFetcher.h"
+#include "TTSClipStore.h"
+#include "TTSStatistics.h"
+#include "TTSTextSanitizer.h"
+#include "TTSSpeechQueue.h"
 
 // --- //
 
@@ -41,45 +51,130 @@ namespace TTS {
 
 // --- //
 
+class TTSConfigurationUpdate;
+
+// Immutable, versioned snapshot of the configuration (see TTSConfigurationStore)
 class TTSConfiguration {
 public:
+    // Fields of the configuration, a partial update carries only the ones set
+    enum Field {
+        ENDPOINT        = 1 << 0,
+        SECURE_ENDPOINT = 1 << 1,
+        LANGUAGE        = 1 << 2,
+        VOICE           = 1 << 3,
+        VOLUME          = 1 << 4,
+        RATE            = 1 << 5,
+        LANGUAGE_VOICES = 1 << 6,   // voice_for_<language> keys of tts.ini
+    };
+
     TTSConfiguration();
     ~TTSConfiguration();
 
-    void setEndPoint(const rtString endpoint);
-    void setSecureEndPoint(const rtString endpoint);
-    void setLanguage(const rtString language);
-    void setVoice(const rtString voice);
-    void setVolume(const double volume);
-    void setRate(const uint8_t rate);
-    void setPreemptiveSpeak(const bool preemptive);
-
-    const rtString &endPoint() { return m_ttsEndPoint; }
-    const rtString &secureEndPoint() { return m_ttsEndPointSecured; }
-    const rtString &language() { return m_language; }
-    const double &volume() { return m_volume; }
-    const uint8_t &rate() { return m_rate; }
-    bool isPreemptive() { return m_preemptiveSpeaking; }
-    const rtString &voice();
-
-    void updateWith(TTSConfiguration &config);
-    bool isValid();
+    const rtString &endPoint() const { return m_ttsEndPoint; }
+    const rtString &secureEndPoint() const { return m_ttsEndPointSecured; }
+    const rtString &language() const { return m_language; }
+    const double &volume() const { return m_volume; }
+    const uint8_t &rate() const { return m_rate; }
+    const rtString &voice() const { return m_voice.isEmpty() ? m_languageVoice : m_voice; }
+    const std::map<std::string, std::string> &languageVoices() const { return m_languageVoices; }
+    uint64_t version() const { return m_version; }
+
+    // Request URL up to the text (endpoint, voice, language & rate), values escaped
+    const std::string &urlPrefix(bool secure) const { return secure ? m_secureUrlPrefix : m_urlPrefix; }
 
+    // Applies the fields set in the update, returns the fields which changed
+    uint32_t apply(const TTSConfigurationUpdate &update);
+    bool isValid() const;
+
+    // Rest of tts.ini, as read at the start
     static std::map<std::string, std::string> m_others;
 
 private:
+    friend class TTSConfigurationStore;
+
+    bool setEndPoint(const rtString &endpoint);
+    bool setSecureEndPoint(const rtString &endpoint);
+    bool setLanguage(const rtString &language);
+    bool setVoice(const rtString &voice);
+    bool setVolume(const double volume);
+    bool setRate(const uint8_t rate);
+    void buildURLPrefixes();
+
     rtString m_ttsEndPoint;
     rtString m_ttsEndPointSecured;
     rtString m_language;
     rtString m_voice;
+    rtString m_languageVoice;   // Voice of the language, if no voice is set
+    double m_volume;
+    uint8_t m_rate;
+    std::map<std::string, std::string> m_languageVoices;
+    std::string m_urlPrefix;
+    std::string m_secureUrlPrefix;
+    uint64_t m_version;
+};
+
+typedef std::shared_ptr<const TTSConfiguration> TTSConfigurationPtr;
+
+// Typed partial update of the configuration
+class TTSConfigurationUpdate {
+public:
+    TTSConfigurationUpdate() : m_fields(0), m_volume(0), m_rate(0) {}
+
+    void setEndPoint(const rtString &endpoint) { m_endPoint = endpoint; m_fields |= TTSConfiguration::ENDPOINT; }
+    void setSecureEndPoint(const rtString &endpoint) { m_secureEndPoint = endpoint; m_fields |= TTSConfiguration::SECURE_ENDPOINT; }
+    void setLanguage(const rtString &language) { m_language = language; m_fields |= TTSConfiguration::LANGUAGE; }
+    void setVoice(const rtString &voice) { m_voice = voice; m_fields |= TTSConfiguration::VOICE; }
+    void setVolume(const double volume) { m_volume = volume; m_fields |= TTSConfiguration::VOLUME; }
+    void setRate(const uint8_t rate) { m_rate = rate; m_fields |= TTSConfiguration::RATE; }
+    void setLanguageVoices(std::map<std::string, std::string> &&voices) {
+        m_languageVoices = std::move(voices);
+        m_fields |= TTSConfiguration::LANGUAGE_VOICES;
+    }
+
+    uint32_t fields() const { return m_fields; }
+
+private:
+    friend class TTSConfiguration;
+
+    uint32_t m_fields;
+    rtString m_endPoint;
+    rtString m_secureEndPoint;
+    rtString m_language;
+    rtString m_voice;
     double m_volume;
     uint8_t m_rate;
-    bool m_preemptiveSpeaking;
+    std::map<std::string, std::string> m_languageVoices;
+};
+
+// Holds the current configuration. Sessions & the speaker share the snapshot by pointer,
+// an update publishes a new snapshot (of the next version) only if some field changed.
+class TTSConfigurationStore {
+public:
+    TTSConfigurationStore() : m_current(std::make_shared<TTSConfiguration>()), m_version(0) {}
+
+    TTSConfigurationPtr current() const { return std::atomic_load(&m_current); }
+
+    // Lock-free as long as the snapshot held is still the current one
+    void refresh(TTSConfigurationPtr &snapshot) const {
+        if(!snapshot || snapshot->version() != m_version.load(std::memory_order_acquire))
+            snapshot = current();
+    }
+
+    // Returns the fields which changed
+    uint32_t update(const TTSConfigurationUpdate &update);
+
+private:
+    TTSConfigurationStore(const TTSConfigurationStore&) = delete;
+
+    TTSConfigurationPtr m_current;
+    std::atomic<uint64_t> m_version;    // Of m_current, published after it
+    std::mutex m_mutex;
 };
 
 class TTSSpeakerClient {
 public:
-    virtual TTSConfiguration* configuration() = 0;
+    virtual bool isPreemptive() = 0;
+    virtual uint8_t priority() = 0;
     virtual void willSpeak(uint32_t speech_id, rtString text) = 0;
     virtual void started(uint32_t speech_id, rtString text) = 0;
     virtual void spoke(uint32_t speech_id, rtString text) = 0;
@@ -91,67 +186,151 @@ public:
     virtual void playbackerror(uint32_t speech_id) = 0;
 };
 
-struct SpeechData {
-    public:
-        SpeechData() : client(NULL), secure(false), id(0), text() {}
-        SpeechData(TTSSpeakerClient *c, uint32_t i, rtString t, bool s=false) : client(c), secure(s), id(i), text(t) {}
-        SpeechData(const SpeechData &n) {
-            client = n.client;
-            id = n.id;
-            text = n.text;
-            secure = n.secure;
-        }
-        ~SpeechData() {}
-
-        TTSSpeakerClient *client;
-        bool secure;
-        uint32_t id;
-        rtString text;
+// What the speaker is doing, as seen by the queries (isSpeaking, getSpeechState)
+struct SpeakingState {
+    const TTSSpeakerClient *client;
+    uint32_t speechId;          // Valid only when hasSpeech
+    bool speaking;
+    bool hasSpeech;             // Speech handed to the pipeline
+    bool paused;
+    uint8_t priority;
+    uint64_t queueGeneration;   // Changes whenever a speech enters / leaves the queue
+};
+
+// Seqlock over SpeakingState, the writers (serialized by the speaker's m_stateMutex) never
+// wait for the readers & the readers never block, they only retry across a concurrent write.
+// The queue generation is a counter of its own, bumped holding the speaker's m_queueMutex.
+class SpeakingStateSnapshot {
+public:
+    SpeakingStateSnapshot() : m_sequence(0), m_client(NULL), m_speechId(0), m_flags(0), m_queueGeneration(0) {}
+
+    void publish(const TTSSpeakerClient *client, uint32_t speechId, bool speaking, bool hasSpeech, bool paused, uint8_t priority);
+    void queueChanged() { m_queueGeneration.fetch_add(1, std::memory_order_release); }
+    uint64_t queueGeneration() const { return m_queueGeneration.load(std::memory_order_acquire); }
+    SpeakingState read() const;
+
+private:
+    SpeakingStateSnapshot(const SpeakingStateSnapshot&) = delete;
+
+    std::atomic<uint32_t> m_sequence;   // Odd while a write is in progress
+    std::atomic<const TTSSpeakerClient*> m_client;
+    std::atomic<uint32_t> m_speechId;
+    std::atomic<uint32_t> m_flags;      // speaking | hasSpeech | paused | priority
+    std::atomic<uint64_t> m_queueGeneration;
+};
+
+// Last pending lookup of a client's getSpeechState(), reused while the queue generation holds
+struct SpeechStateQuery {
+    SpeechStateQuery() : id(0), generation(0), valid(false), pending(false) {}
+
+    uint32_t id;
+    uint64_t generation;
+    bool valid;
+    bool pending;
 };
 
 class TTSSpeaker {
 public:
-    TTSSpeaker(TTSConfiguration &config);
+    TTSSpeaker(TTSConfigurationStore &config);
     ~TTSSpeaker();
 
     void ensurePipeline(bool flag=true);
 
+    // Under PRIORITY policy, speeches are queued by the priority of the client
+    // & a higher priority speech interrupts (or suspends) the lower one being spoken
+    void setPriorityScheduling(bool enable);
+
     // Speak Functions
     int speak(TTSSpeakerClient* client, uint32_t id, rtString text, bool secure); // Formalize data to speak API
-    bool isSpeaking(const TTSSpeakerClient *client = NULL);
-    SpeechState getSpeechState(const TTSSpeakerClient *client, uint32_t id);
+    // Queues the speeches of a batch at once, a preemptive client interrupts only what was queued before the batch
+    int speak(TTSSpeakerClient* client, std::vector<SpeechData> &&speeches);
+    bool isSpeaking(const TTSSpeakerClient *client = NULL) const;
+    // Lock-free unless the queue changed since the query (when given) was last answered
+    SpeechState getSpeechState(const TTSSpeakerClient *client, uint32_t id, SpeechStateQuery *query = NULL);
     void clearAllSpeechesFrom(const TTSSpeakerClient *client, std::vector<uint32_t> &speechesCancelled);
-    void cancelCurrentSpeech();
+    void forgetClient(const TTSSpeakerClient *client); // Client is destroyed, after its speeches are cleared
+    // With a client, only its speech is cancelled
+    void cancelCurrentSpeech(const TTSSpeakerClient *client = NULL);
     bool reset();
 
     void pause(uint32_t id = 0);
     void resume(uint32_t id = 0);
 
+    // Drops the audio fetched with an older endpoint / voice / language
+    // & reloads the normalization rules (volume & rate need nothing of this)
+    void configurationChanged();
+
+    TTSAudioCache::Statistics cacheStatistics() { return m_audioCache.statistics(); }
+    TTSClipStore::Statistics clipStoreStatistics() { return m_clipStore.statistics(); }
+    TTSStatistics &statistics() { return m_statistics; }
+
 private:
 
     // Private Data
-    TTSConfiguration &m_defaultConfig;
+    TTSConfigurationStore &m_configuration;
+    TTSConfigurationPtr m_speakingConfig;   // Snapshot of the GStreamer thread (prefetch & speak)
     TTSSpeakerClient *m_clientSpeaking;
     SpeechData *m_currentSpeech;
     bool m_isSpeaking;
     bool m_isPaused;
+    uint8_t m_speakingPriority;
+    std::atomic<bool> m_priorityScheduling;
+    std::atomic<bool> m_preempted;
+    const bool m_resumePreempted;
+    void preemptLowerThan(uint8_t priority);
+    // m_queueMutex held, a preempted speech is then either still current or requeued.
+    // Unless resumable, the speech isn't suspended even if it was preempted before
+    void cancelSpeaking(const TTSSpeakerClient *client, bool resumable);
+    void resetPriority(uint8_t priority);
+    uint8_t preparePriority(TTSSpeakerClient *client);
 
+    // Serializes the state changes, m_state republishes them for the queries
     std::mutex m_stateMutex;
     std::condition_variable m_condition;
+    SpeakingStateSnapshot m_state;
+    void publishState();
 
-    std::list<SpeechData> m_queue;
+    TTSSpeechQueue m_queue;
     std::mutex m_queueMutex;
-    void queueData(SpeechData);
+    void queueData(SpeechData &&data);
+    void queueData(std::vector<SpeechData> &&speeches);
     void flushQueue();
-    SpeechData dequeueData();
+    TTSSpeechQueue::Entry *dequeueData(); // NULL when the queue got emptied meanwhile
+    void releaseData(TTSSpeechQueue::Entry *entry);
+    void requeueData(TTSSpeechQueue::Entry *entry); // m_queueMutex held
+
+    // Audio of the first m_prefetchDepth queued speeches is fetched ahead, called with
+    // m_queueMutex held, which is released while the URLs are built & the fetches started
+    const uint32_t m_prefetchDepth;
+    const uint32_t m_maxSegmentLength;
+    bool m_prefetchPending;
+    void prefetchQueued(std::unique_lock<std::mutex> &lock);
+    void dropPrefetched(SpeechData &data);
+
+    TTSStatistics m_statistics;
+
+    // Normalization rules of the language, compiled (m_normalizerMutex)
+    std::shared_ptr<const TTSNormalizer> m_normalizer;
+    std::string m_normalizerLanguage;
+    std::mutex m_normalizerMutex;
+    std::shared_ptr<const TTSNormalizer> normalizerFor(const rtString &language);
+
+    // Audio data, must be constructed before the GStreamer thread starts
+    TTSAudioCache m_audioCache;
+    TTSClipStore m_clipStore;
+    TTSAudioFetcher m_audioFetcher;
+    std::vector<AudioClipPtr> m_feedingClips;
+    std::mutex m_feedMutex;
 
     // Private functions
-    inline void setSpeakingState(bool state, TTSSpeakerClient *client=NULL);
+    inline void setSpeakingState(bool state, TTSSpeakerClient *client=NULL, uint8_t priority=0);
+    void setCurrentSpeech(SpeechData *data);
 
     // GStreamer Releated members
     GstElement *m_pipeline;
     GstElement *m_source;
     GstElement *m_audioSink;
+    GstElement *m_volume;       // Element having the "volume" property, the sink itself on SoCs
     bool        m_pipelineError;
     bool        m_networkError;
     bool        m_runThread;
@@ -160,28 +339,50 @@ private:
     bool        m_ensurePipeline;
     std::thread *m_gstThread;
     guint       m_busWatch;
-    gint64      m_duration;
+    std::atomic<gint64> m_duration; // Written by the bus, read by the GStreamer thread
     uint8_t     m_pipelineConstructionFailures;
     const uint8_t     m_maxPipelineConstructionFailures;
 
+    // Warm mode keeps the pipeline (sink & decoder) in READY between the speeches
+    const bool  m_warmPipeline;
+    std::atomic<bool> m_firstAudioPending;
+    std::atomic<bool> m_audioProgressed;
+
+    // Last settled state of the pipeline, tracked from the bus messages (m_queueMutex),
+    // which may lag behind, waitForStatus() confirms it with pipelineIs()
+    GstState    m_pipelineState;
+    std::chrono::steady_clock::time_point m_speakStartTime;
+
+    // Scratch buffers of constructURLs() (GStreamer thread only), kept so that their capacity is reused
+    using TextRange = std::pair<size_t, size_t>;    // [begin, end) offsets of a segment
+    std::string m_normalizedText;
+    std::string m_sanitizedText;
+    std::vector<TextRange> m_segments;
+    std::vector<std::string> m_urls;
+
     static void GStreamerThreadFunc(void *ctx);
     void createPipeline();
     void resetPipeline();
     void destroyPipeline();
+    GstState idleState() { return m_warmPipeline ? GST_STATE_READY : GST_STATE_NULL; }
 
     // GStreamer Helper functions
     bool needsPipelineUpdate();
-    std::string constructURL(TTSConfiguration &config, SpeechData &d);
-    bool isSilentPunctuation(const char c);
-    void replaceSuccesivePunctuation(std::string& subject);
-    void replaceIfIsolated(std::string& subject, const std::string& search, const std::string& replace);
-    void curlSanitize(std::string &url);
-    void sanitizeString(rtString &input, std::string &sanitizedString);
-    void speakText(TTSConfiguration config, SpeechData &data);
+    bool constructURLs(const TTSConfiguration &config, SpeechData &d, std::vector<std::string> &urls);
+    void segmentText(const std::string &text, std::vector<TextRange> &segments);
+    void sanitizeString(const TTSNormalizer &normalizer, rtString &input, std::string &sanitizedString);
+    void speakText(const TTSConfiguration &config, SpeechData &data);
+    uint64_t clipVersion(const TTSConfiguration &config);
+    AudioClipPtr fetchAudio(const std::string &url);
+    bool feedAudio(const std::vector<AudioClipPtr> &clips);
+    void interruptFeed();
+    bool setPipelineState(GstState state, uint32_t timeout_ms);
+    bool pipelineIs(GstState state);
     bool waitForStatus(GstState expected_state, uint32_t timeout_ms);
     void waitForAudioToFinishTimeout(float timeout_s);
     bool handleMessage(GstMessage*);
     static int GstBusCallback(GstBus *bus, GstMessage *message, gpointer data);
+    static GstPadProbeReturn AudioProgressProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
 };
 
 } // namespace TTS
@@ -0,0 +1,201 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "TTSSpeechQueue.h"
+
+namespace TTS {
+
+TTSSpeechQueue::TTSSpeechQueue(uint32_t chunkSize) :
+    m_chunkSize(chunkSize ? chunkSize : 1),
+    m_free(NULL),
+    m_head(NULL),
+    m_tail(NULL),
+    m_size(0) {
+    for(int i = 0; i < TTS_PRIORITY_TIERS; ++i)
+        m_tierTail[i] = NULL;
+    rehash(m_chunkSize * 2);
+}
+
+TTSSpeechQueue::~TTSSpeechQueue() {
+    for(auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+        delete [] *it;
+}
+
+TTSSpeechQueue::Entry *TTSSpeechQueue::allocate() {
+    if(!m_free) {
+        Entry *chunk = new Entry[m_chunkSize];
+        m_chunks.push_back(chunk);
+        for(uint32_t i = 0; i < m_chunkSize; ++i) {
+            chunk[i].next = m_free;
+            m_free = &chunk[i];
+        }
+    }
+
+    Entry *entry = m_free;
+    m_free = entry->next;
+    return entry;
+}
+
+void TTSSpeechQueue::release(Entry *entry) {
+    // Drops the text & clips, the clips vector keeps its capacity
+    entry->data.text = rtString();
+    entry->data.clips.clear();
+    entry->next = m_free;
+    m_free = entry;
+}
+
+size_t TTSSpeechQueue::bucket(const TTSSpeakerClient *client, uint32_t id) const {
+    uint64_t h = ((uint64_t)(uintptr_t)client ^ ((uint64_t)id << 32 | id)) * 0x9E3779B97F4A7C15ULL;
+    return (h >> 32) & (m_buckets.size() - 1);
+}
+
+void TTSSpeechQueue::rehash(size_t buckets) {
+    size_t size = 1;
+    while(size < buckets)
+        size <<= 1;
+
+    m_buckets.assign(size, NULL);
+    for(Entry *entry = m_head; entry; entry = entry->next) {
+        Entry *&head = m_buckets[bucket(entry->data.client, entry->data.id)];
+        entry->hashNext = head;
+        head = entry;
+    }
+}
+
+void TTSSpeechQueue::push(SpeechData &&data) {
+    Entry *entry = allocate();
+    entry->data = std::move(data);
+    link(entry, false);
+}
+
+void TTSSpeechQueue::requeue(Entry *entry) {
+    link(entry, true);
+}
+
+void TTSSpeechQueue::link(Entry *entry, bool front) {
+    if(m_size + 1 > m_buckets.size())
+        rehash(m_buckets.size() * 2);
+
+    // Goes after the last entry of the same (unless to the front) or a higher priority
+    uint8_t priority = entry->data.priority;
+    Entry *after = NULL;
+    for(int tier = front ? priority + 1 : priority; tier < TTS_PRIORITY_TIERS && !after; ++tier)
+        after = m_tierTail[tier];
+
+    entry->prev = after;
+    entry->next = after ? after->next : m_head;
+    if(entry->next)
+        entry->next->prev = entry;
+    else
+        m_tail = entry;
+    if(after)
+        after->next = entry;
+    else
+        m_head = entry;
+    if(!front || !m_tierTail[priority])
+        m_tierTail[priority] = entry;
+
+    // Per client order follows the queue order
+    ClientList &list = m_clients[entry->data.client];
+    Entry *clientAfter = list.tail;
+    while(clientAfter && clientAfter->data.priority < priority)
+        clientAfter = clientAfter->clientPrev;
+    while(front && clientAfter && clientAfter->data.priority == priority)
+        clientAfter = clientAfter->clientPrev;
+
+    entry->clientPrev = clientAfter;
+    entry->clientNext = clientAfter ? clientAfter->clientNext : list.head;
+    if(entry->clientNext)
+        entry->clientNext->clientPrev = entry;
+    else
+        list.tail = entry;
+    if(clientAfter)
+        clientAfter->clientNext = entry;
+    else
+        list.head = entry;
+
+    m_size++;
+    Entry *&head = m_buckets[bucket(entry->data.client, entry->data.id)];
+    entry->hashNext = head;
+    head = entry;
+}
+
+TTSSpeechQueue::Entry *TTSSpeechQueue::pop() {
+    Entry *entry = m_head;
+    if(entry)
+        unlink(entry);
+    return entry;
+}
+
+bool TTSSpeechQueue::contains(const TTSSpeakerClient *client, uint32_t id) const {
+    for(Entry *entry = m_buckets[bucket(client, id)]; entry; entry = entry->hashNext) {
+        if(entry->data.id == id && entry->data.client == client)
+            return true;
+    }
+    return false;
+}
+
+SpeechData *TTSSpeechQueue::find(const TTSSpeakerClient *client, uint32_t id) {
+    for(Entry *entry = m_buckets[bucket(client, id)]; entry; entry = entry->hashNext) {
+        if(entry->data.id == id && entry->data.client == client)
+            return &entry->data;
+    }
+    return NULL;
+}
+
+void TTSSpeechQueue::forgetClient(const TTSSpeakerClient *client) {
+    auto it = m_clients.find(client);
+    if(it != m_clients.end() && !it->second.head)
+        m_clients.erase(it);
+}
+
+void TTSSpeechQueue::unlink(Entry *entry) {
+    if(entry->prev)
+        entry->prev->next = entry->next;
+    else
+        m_head = entry->next;
+    if(entry->next)
+        entry->next->prev = entry->prev;
+    else
+        m_tail = entry->prev;
+
+    uint8_t priority = entry->data.priority;
+    if(m_tierTail[priority] == entry)
+        m_tierTail[priority] = (entry->prev && entry->prev->data.priority == priority) ? entry->prev : NULL;
+
+    // The client's list is kept (even if empty), so that the steady state doesn't allocate
+    ClientList &list = m_clients[entry->data.client];
+    if(entry->clientPrev)
+        entry->clientPrev->clientNext = entry->clientNext;
+    else
+        list.head = entry->clientNext;
+    if(entry->clientNext)
+        entry->clientNext->clientPrev = entry->clientPrev;
+    else
+        list.tail = entry->clientPrev;
+
+    Entry **link = &m_buckets[bucket(entry->data.client, entry->data.id)];
+    while(*link != entry)
+        link = &(*link)->hashNext;
+    *link = entry->hashNext;
+
+    m_size--;
+}
+
+} // namespace TTS
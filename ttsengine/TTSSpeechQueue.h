@@ -0,0 +1,171 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_SPEECH_QUEUE_H_
+#define _TTS_SPEECH_QUEUE_H_
+
+#include <rtRemote.h>
+
+#include <stdint.h>
+
+#include <vector>
+#include <unordered_map>
+
+#include "TTSAudioCache.h"
+#include "TTSStatistics.h"
+
+namespace TTS {
+
+class TTSSpeakerClient;
+
+struct SpeechData {
+    public:
+        SpeechData() : client(NULL), secure(false), id(0), priority(0), text() {}
+        SpeechData(TTSSpeakerClient *c, uint32_t i, rtString t, bool s=false, uint8_t p=0) :
+            client(c), secure(s), id(i), priority(p < TTS_PRIORITY_TIERS ? p : TTS_MAX_PRIORITY), text(t) {
+            timeline.id = i;
+            timeline.priority = priority;
+        }
+        SpeechData(SpeechData &&n) = default;
+        SpeechData &operator=(SpeechData &&n) = default;
+        SpeechData(const SpeechData &n) = delete;
+        SpeechData &operator=(const SpeechData &n) = delete;
+        ~SpeechData() {}
+
+        TTSSpeakerClient *client;
+        bool secure;
+        uint32_t id;
+        uint8_t priority;
+        rtString text;
+        std::vector<AudioClipPtr> clips; // Prefetched audio, one clip per text segment
+        SpeechTimeline timeline;
+};
+
+// FIFO of the speeches (higher priority first, FIFO within a priority), with every
+// speech also linked in its client's list and in a hash index on (client, id).
+// Entries come from a pool which grows in chunks & is never shrunk, so that the
+// steady state doesn't allocate. Not thread safe.
+class TTSSpeechQueue {
+public:
+    class Entry {
+    public:
+        SpeechData data;
+
+    private:
+        friend class TTSSpeechQueue;
+        Entry *prev;
+        Entry *next;
+        Entry *clientPrev;
+        Entry *clientNext;
+        Entry *hashNext;
+    };
+
+    TTSSpeechQueue(uint32_t chunkSize = 32);
+    ~TTSSpeechQueue();
+
+    bool empty() const { return !m_head; }
+    uint32_t size() const { return m_size; }
+
+    void push(SpeechData &&data);
+    // Puts a popped entry back, at the front of its priority
+    void requeue(Entry *entry);
+
+    // Unlinks the front entry, which stays valid until release()
+    Entry *pop();
+    void release(Entry *entry);
+
+    bool contains(const TTSSpeakerClient *client, uint32_t id) const;
+    SpeechData *find(const TTSSpeakerClient *client, uint32_t id);
+
+    // Calls f(SpeechData&) for every speech of the client (in queue order)
+    // before it is removed from the queue, the client's (empty) list is kept
+    template<typename F> void removeClient(const TTSSpeakerClient *client, F f) {
+        auto it = m_clients.find(client);
+        if(it == m_clients.end())
+            return;
+
+        while(it->second.head) {
+            Entry *entry = it->second.head;
+            f(entry->data);
+            unlink(entry);
+            release(entry);
+        }
+    }
+
+    // Drops the client's list once the client is gone (if it has no speeches left)
+    void forgetClient(const TTSSpeakerClient *client);
+
+    template<typename F> void clear(F f) {
+        while(m_head) {
+            Entry *entry = m_head;
+            f(entry->data);
+            unlink(entry);
+            release(entry);
+        }
+    }
+
+    template<typename F> void clearPriority(uint8_t priority, F f) {
+        if(priority >= TTS_PRIORITY_TIERS)
+            return;
+
+        while(m_tierTail[priority]) {
+            Entry *entry = m_tierTail[priority];
+            f(entry->data);
+            unlink(entry);
+            release(entry);
+        }
+    }
+
+    // Visits the speeches in queue order while f(SpeechData&) returns true
+    template<typename F> void forEach(F f) {
+        for(Entry *entry = m_head; entry; entry = entry->next) {
+            if(!f(entry->data))
+                break;
+        }
+    }
+
+private:
+    struct ClientList {
+        ClientList() : head(NULL), tail(NULL) {}
+
+        Entry *head;
+        Entry *tail;
+    };
+
+    const uint32_t m_chunkSize;
+    std::vector<Entry*> m_chunks;
+    Entry *m_free;
+
+    Entry *m_head;
+    Entry *m_tail;
+    Entry *m_tierTail[TTS_PRIORITY_TIERS];
+    uint32_t m_size;
+
+    std::unordered_map<const TTSSpeakerClient*, ClientList> m_clients;
+    std::vector<Entry*> m_buckets;
+
+    Entry *allocate();
+    void link(Entry *entry, bool front);
+    void unlink(Entry *entry);
+    size_t bucket(const TTSSpeakerClient *client, uint32_t id) const;
+    void rehash(size_t buckets);
+};
+
+} // namespace TTS
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "TTSStatistics.h"
+
+#include <time.h>
+#include <algorithm>
+
+namespace TTS {
+
+const char *stageName(SpeechStage stage) {
+    switch(stage) {
+        case STAGE_ENQUEUED: return "enqueued";
+        case STAGE_DEQUEUED: return "dequeued";
+        case STAGE_URL_BUILT: return "urlBuilt";
+        case STAGE_FIRST_BYTE: return "firstByte";
+        case STAGE_PAUSED: return "paused";
+        case STAGE_PLAYING: return "playing";
+        case STAGE_EOS: return "eos";
+        case STAGE_SPOKE: return "spoke";
+        default: return "unknown";
+    }
+}
+
+const char *outcomeName(SpeechOutcome outcome) {
+    switch(outcome) {
+        case OUTCOME_SPOKE: return "spoke";
+        case OUTCOME_INTERRUPTED: return "interrupted";
+        case OUTCOME_NETWORK_ERROR: return "networkerror";
+        case OUTCOME_PLAYBACK_ERROR: return "playbackerror";
+        default: return "none";
+    }
+}
+
+uint64_t SpeechTimeline::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+double SpeechTimeline::offset(SpeechStage stage) const {
+    if(!stamps[stage] || !stamps[STAGE_ENQUEUED])
+        return -1;
+    return (double)(stamps[stage] - stamps[STAGE_ENQUEUED]) / 1000000.0;
+}
+
+// --- //
+
+TTSStatistics::TTSStatistics(uint32_t history, uint32_t samples) :
+    m_history(history ? history : 1),
+    m_historyNext(0),
+    m_historyCount(0) {
+    for(int i = 0; i < STAGE_COUNT; ++i) {
+        m_samples[i].resize(samples ? samples : 1);
+        m_samplesNext[i] = 0;
+        m_samplesCount[i] = 0;
+    }
+    for(int i = 0; i < TTS_PRIORITY_TIERS; ++i) {
+        m_startSamples[i].resize(samples ? samples : 1);
+        m_startSamplesNext[i] = 0;
+        m_startSamplesCount[i] = 0;
+        m_preemptions[i] = 0;
+    }
+}
+
+TTSStatistics::~TTSStatistics() {
+}
+
+void TTSStatistics::record(const SpeechTimeline &timeline) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_history[m_historyNext] = timeline;
+    m_historyNext = (m_historyNext + 1) % m_history.size();
+    if(m_historyCount < m_history.size())
+        m_historyCount++;
+
+    for(int i = STAGE_DEQUEUED; i < STAGE_COUNT; ++i) {
+        double offset = timeline.offset((SpeechStage)i);
+        if(offset >= 0)
+            addSample(m_samples[i], m_samplesNext[i], m_samplesCount[i], offset);
+    }
+
+    double start = timeline.offset(STAGE_PLAYING);
+    uint8_t tier = timeline.priority < TTS_PRIORITY_TIERS ? timeline.priority : TTS_MAX_PRIORITY;
+    if(start >= 0)
+        addSample(m_startSamples[tier], m_startSamplesNext[tier], m_startSamplesCount[tier], start);
+}
+
+void TTSStatistics::preempted(uint8_t priority) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(priority < TTS_PRIORITY_TIERS)
+        m_preemptions[priority]++;
+}
+
+void TTSStatistics::addSample(std::vector<double> &samples, uint32_t &next, uint32_t &count, double value) {
+    samples[next] = value;
+    next = (next + 1) % samples.size();
+    if(count < samples.size())
+        count++;
+}
+
+void TTSStatistics::timelines(std::vector<SpeechTimeline> &timelines) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    timelines.clear();
+    for(uint32_t i = 1; i <= m_historyCount; ++i)
+        timelines.push_back(m_history[(m_historyNext + m_history.size() - i) % m_history.size()]);
+}
+
+TTSStatistics::Percentiles TTSStatistics::percentiles(SpeechStage stage) {
+    std::vector<double> sorted;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        sorted.assign(m_samples[stage].begin(), m_samples[stage].begin() + m_samplesCount[stage]);
+    }
+
+    return percentilesOf(sorted);
+}
+
+TTSStatistics::Percentiles TTSStatistics::startPercentiles(uint8_t priority) {
+    std::vector<double> sorted;
+    if(priority < TTS_PRIORITY_TIERS) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        sorted.assign(m_startSamples[priority].begin(), m_startSamples[priority].begin() + m_startSamplesCount[priority]);
+    }
+
+    return percentilesOf(sorted);
+}
+
+uint32_t TTSStatistics::preemptions(uint8_t priority) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return priority < TTS_PRIORITY_TIERS ? m_preemptions[priority] : 0;
+}
+
+TTSStatistics::Percentiles TTSStatistics::percentilesOf(std::vector<double> &sorted) {
+    Percentiles p;
+    if(sorted.empty())
+        return p;
+
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&sorted] (double q) { return sorted[std::min(sorted.size() - 1, (size_t)(q * sorted.size()))]; };
+
+    p.count = sorted.size();
+    p.p50 = at(0.50);
+    p.p95 = at(0.95);
+    p.p99 = at(0.99);
+    return p;
+}
+
+} // namespace TTS
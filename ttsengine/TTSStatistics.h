@@ -0,0 +1,122 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_STATISTICS_H_
+#define _TTS_STATISTICS_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <mutex>
+#include <vector>
+
+#include "TTSCommon.h"
+
+namespace TTS {
+
+enum SpeechStage {
+    STAGE_ENQUEUED = 0,
+    STAGE_DEQUEUED,
+    STAGE_URL_BUILT,
+    STAGE_FIRST_BYTE,
+    STAGE_PAUSED,
+    STAGE_PLAYING,
+    STAGE_EOS,
+    STAGE_SPOKE,
+    STAGE_COUNT
+};
+
+enum SpeechOutcome {
+    OUTCOME_NONE = 0,
+    OUTCOME_SPOKE,
+    OUTCOME_INTERRUPTED,
+    OUTCOME_NETWORK_ERROR,
+    OUTCOME_PLAYBACK_ERROR
+};
+
+const char *stageName(SpeechStage stage);
+const char *outcomeName(SpeechOutcome outcome);
+
+// Monotonic timestamps (ns) of the stages a speech went through, 0 if not reached.
+// Plain data, so that marking a stage is just a clock read.
+struct SpeechTimeline {
+    SpeechTimeline() : id(0), priority(0), outcome(OUTCOME_NONE) { memset(stamps, 0, sizeof(stamps)); }
+
+    void mark(SpeechStage stage) { stamps[stage] = now(); }
+    void markOnce(SpeechStage stage) { if(!stamps[stage]) mark(stage); }
+
+    // Milliseconds since enqueue, -1 if the stage is not reached
+    double offset(SpeechStage stage) const;
+
+    static uint64_t now();
+
+    uint32_t id;
+    uint8_t priority;
+    SpeechOutcome outcome;
+    uint64_t stamps[STAGE_COUNT];
+};
+
+// Keeps the last N timelines & a window of the latest samples (time since enqueue)
+// of every stage, and of the start (PLAYING) of every priority tier, for the percentiles.
+// Memory is allocated upfront, record() doesn't allocate.
+class TTSStatistics {
+public:
+    struct Percentiles {
+        Percentiles() : count(0), p50(0), p95(0), p99(0) {}
+
+        uint32_t count;
+        double p50;
+        double p95;
+        double p99;
+    };
+
+    TTSStatistics(uint32_t history, uint32_t samples = 256);
+    ~TTSStatistics();
+
+    void record(const SpeechTimeline &timeline);
+    void preempted(uint8_t priority);
+
+    // Latest first
+    void timelines(std::vector<SpeechTimeline> &timelines);
+    Percentiles percentiles(SpeechStage stage);
+    Percentiles startPercentiles(uint8_t priority);
+    uint32_t preemptions(uint8_t priority);
+
+private:
+    std::vector<SpeechTimeline> m_history;
+    uint32_t m_historyNext;
+    uint32_t m_historyCount;
+
+    std::vector<double> m_samples[STAGE_COUNT];
+    uint32_t m_samplesNext[STAGE_COUNT];
+    uint32_t m_samplesCount[STAGE_COUNT];
+
+    std::vector<double> m_startSamples[TTS_PRIORITY_TIERS];
+    uint32_t m_startSamplesNext[TTS_PRIORITY_TIERS];
+    uint32_t m_startSamplesCount[TTS_PRIORITY_TIERS];
+    uint32_t m_preemptions[TTS_PRIORITY_TIERS];
+
+    static void addSample(std::vector<double> &samples, uint32_t &next, uint32_t &count, double value);
+    static Percentiles percentilesOf(std::vector<double> &sorted);
+
+    std::mutex m_mutex;
+};
+
+} // namespace TTS
+
+#endif
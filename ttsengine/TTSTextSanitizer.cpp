@@ -0,0 +1,252 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "TTSTextSanitizer.h"
+
+#include <string.h>
+
+#include <fstream>
+
+namespace TTS {
+
+namespace {
+
+enum CharClass {
+    CHAR_SPACE      = 1 << 0,
+    CHAR_PUNCT      = 1 << 1,
+    CHAR_SILENT     = 1 << 2,   // Punctuation not to be repeated
+    CHAR_STRAY      = 1 << 3,   // Dropped
+    CHAR_UNRESERVED = 1 << 4    // Not percent-encoded
+};
+
+constexpr bool isIn(const char *set, int c) {
+    for(; *set; ++set)
+        if(*set == c)
+            return true;
+    return false;
+}
+
+// Character classes of the "C" locale, built at compile time
+struct CharTable {
+    uint8_t classes[256];
+
+    constexpr CharTable() : classes() {
+        for(int c = 0; c < 256; ++c) {
+            bool alnum = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+            uint8_t cls = 0;
+            if(c == ' ' || (c >= '\t' && c <= '\r'))
+                cls |= CHAR_SPACE;
+            if(c > ' ' && c < 127 && !alnum)
+                cls |= CHAR_PUNCT;
+            if(isIn("?!:;-()", c))
+                cls |= CHAR_SILENT;
+            if(c == '"')
+                cls |= CHAR_STRAY;
+            if(alnum || isIn("-._~", c))
+                cls |= CHAR_UNRESERVED;
+            classes[c] = cls;
+        }
+    }
+};
+
+constexpr CharTable s_table;
+
+inline bool isQuiet(uint8_t c) {
+    return s_table.classes[c] & (CHAR_SPACE | CHAR_PUNCT);
+}
+
+} // namespace
+
+TTSNormalizer::TTSNormalizer() {
+    compile();
+}
+
+TTSNormalizer::~TTSNormalizer() {
+}
+
+void TTSNormalizer::addRule(const std::string &pattern, const std::string &replacement) {
+    if(!pattern.empty())
+        m_rules[pattern] = replacement;
+}
+
+void TTSNormalizer::addDefaultRules() {
+    addRule("$", "dollar");
+    addRule("#", "pound");
+    addRule("&", "and");
+    addRule("|", "bar");
+    addRule("/", "or");
+}
+
+bool TTSNormalizer::loadRules(const std::string &path) {
+    std::ifstream file(path);
+    if(!file.is_open())
+        return false;
+
+    std::string line;
+    while(std::getline(file, line)) {
+        size_t tab = line.find('\t');
+        if(tab != std::string::npos)
+            addRule(line.substr(0, tab), line.substr(tab + 1));
+    }
+    return true;
+}
+
+void TTSNormalizer::compile() {
+    m_compiled.assign(m_rules.begin(), m_rules.end());
+    m_nodes.clear();
+    m_edges.clear();
+    build(0, m_compiled.size(), 0);
+
+    memset(m_root, 0, sizeof(m_root));
+    for(uint32_t i = 0; i < m_nodes[0].edges; ++i)
+        m_root[m_edges[m_nodes[0].firstEdge + i].c] = m_edges[m_nodes[0].firstEdge + i].node;
+}
+
+// Patterns in [lo, hi) are sorted & share the first "depth" characters,
+// so the children of every node get contiguous edges
+uint32_t TTSNormalizer::build(size_t lo, size_t hi, size_t depth) {
+    uint32_t index = m_nodes.size();
+    m_nodes.push_back({ -1, 0, 0 });
+    if(lo < hi && m_compiled[lo].first.length() == depth)
+        m_nodes[index].rule = lo++;
+
+    std::vector<std::pair<size_t, size_t>> groups;
+    for(size_t i = lo; i < hi;) {
+        size_t j = i + 1;
+        while(j < hi && m_compiled[j].first[depth] == m_compiled[i].first[depth])
+            ++j;
+        groups.push_back(std::make_pair(i, j));
+        i = j;
+    }
+
+    uint32_t firstEdge = m_edges.size();
+    m_nodes[index].firstEdge = firstEdge;
+    m_nodes[index].edges = groups.size();
+    m_edges.resize(firstEdge + groups.size());
+    for(size_t g = 0; g < groups.size(); ++g) {
+        uint32_t node = build(groups[g].first, groups[g].second, depth + 1);
+        m_edges[firstEdge + g].c = m_compiled[groups[g].first].first[depth];
+        m_edges[firstEdge + g].node = node;
+    }
+    return index;
+}
+
+uint32_t TTSNormalizer::child(uint32_t node, uint8_t c) const {
+    const Node &n = m_nodes[node];
+    for(uint32_t i = n.firstEdge; i < n.firstEdge + n.edges; ++i) {
+        if(m_edges[i].c == c)
+            return m_edges[i].node;
+    }
+    return 0;
+}
+
+void TTSNormalizer::normalize(const char *input, size_t length, std::string &out) const {
+    const uint8_t *text = (const uint8_t*)input;
+    bool leftQuiet = true;
+
+    out.clear();
+    out.reserve(length + length / 4);
+
+    size_t run = 0;
+    for(size_t i = 0; i < length;) {
+        uint32_t node = leftQuiet ? m_root[text[i]] : 0;
+        if(node) {
+            // Longest isolated match starting here
+            int32_t rule = -1;
+            size_t end = i + 1;
+            for(size_t j = i + 1; node; ++j) {
+                if(m_nodes[node].rule >= 0 && (j == length || isQuiet(text[j]))) {
+                    rule = m_nodes[node].rule;
+                    end = j;
+                }
+                node = (j < length) ? child(node, text[j]) : 0;
+            }
+
+            if(rule >= 0) {
+                const std::string &replacement = m_compiled[rule].second;
+                out.append(input + run, i - run);
+                out.append(replacement);
+                if(!replacement.empty())
+                    leftQuiet = isQuiet(replacement.back());
+                run = i = end;
+                continue;
+            }
+        }
+
+        leftQuiet = isQuiet(text[i]);
+        ++i;
+    }
+    out.append(input + run, length - run);
+}
+
+void sanitizeText(const char *input, size_t length, std::string &out) {
+    const uint8_t *text = (const uint8_t*)input;
+    bool afterPunct = false;
+
+    out.clear();
+    out.reserve(length + length / 4);
+
+    // Characters kept as they are, are copied in runs
+    size_t run = 0;
+    for(size_t i = 0; i < length; ++i) {
+        uint8_t c = text[i];
+        uint8_t cls = s_table.classes[c];
+
+        if(!(cls & (CHAR_PUNCT | CHAR_SPACE))) {
+            afterPunct = false;
+            continue;
+        }
+
+        if((cls & CHAR_STRAY) || (afterPunct && (cls & CHAR_SILENT))) {
+            out.append(input + run, i - run);
+            run = i + 1;
+            continue;
+        }
+
+        // Spaces don't end a run of punctuation
+        if(!(cls & CHAR_SPACE))
+            afterPunct = true;
+    }
+    out.append(input + run, length - run);
+}
+
+void appendPercentEncoded(const char *input, size_t length, std::string &out) {
+    static const char hex[] = "0123456789ABCDEF";
+    const uint8_t *text = (const uint8_t*)input;
+
+    size_t encoded = 0;
+    for(size_t i = 0; i < length; ++i)
+        encoded += (s_table.classes[text[i]] & CHAR_UNRESERVED) ? 1 : 3;
+
+    size_t pos = out.size();
+    out.resize(pos + encoded);
+    char *dst = &out[pos];
+    for(size_t i = 0; i < length; ++i) {
+        uint8_t c = text[i];
+        if(s_table.classes[c] & CHAR_UNRESERVED) {
+            *dst++ = c;
+        } else {
+            *dst++ = '%';
+            *dst++ = hex[c >> 4];
+            *dst++ = hex[c & 0xF];
+        }
+    }
+}
+
+} // namespace TTS
@@ -0,0 +1,87 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#ifndef _TTS_TEXT_SANITIZER_H_
+#define _TTS_TEXT_SANITIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace TTS {
+
+// Text normalization rules ("$" -> "dollar", "Dr." -> "Doctor" ...) compiled into a trie.
+// A rule applies only to an isolated match, i.e. with punctuation / space (or the text
+// boundary) on both the sides, the longest match wins. Normalization is linear in the
+// text length whatever the number of rules. Not modified after compile(), so a compiled
+// instance can be shared between the threads.
+class TTSNormalizer {
+public:
+    TTSNormalizer();
+    ~TTSNormalizer();
+
+    void addRule(const std::string &pattern, const std::string &replacement);
+    // "$ # & | /" spelt out in English
+    void addDefaultRules();
+    // One "pattern<TAB>replacement" per line, lines without a TAB are ignored
+    bool loadRules(const std::string &path);
+    void compile();
+
+    size_t rules() const { return m_rules.size(); }
+
+    // The output buffer is overwritten, its capacity is reused.
+    void normalize(const char *text, size_t length, std::string &out) const;
+
+private:
+    struct Node {
+        int32_t rule;       // Index in m_compiled, -1 if no pattern ends here
+        uint32_t firstEdge;
+        uint32_t edges;
+    };
+
+    struct Edge {
+        uint8_t c;
+        uint32_t node;
+    };
+
+    std::map<std::string, std::string> m_rules;
+    std::vector<std::pair<std::string, std::string>> m_compiled;
+    std::vector<Node> m_nodes;
+    std::vector<Edge> m_edges;
+    uint32_t m_root[256];   // Children of the root node, 0 if none
+
+    uint32_t build(size_t lo, size_t hi, size_t depth);
+    uint32_t child(uint32_t node, uint8_t c) const;
+};
+
+// Prepares the (normalized) text for the TTS endpoint in a single pass over the input
+// - double quotes are dropped
+// - silent punctuation ("?!:;-()") following a punctuation is dropped
+// The output buffer is overwritten, its capacity is reused.
+void sanitizeText(const char *text, size_t length, std::string &out);
+
+// Appends the percent-encoded text (RFC 3986 unreserved characters are kept as is,
+// same as curl_easy_escape()) to out
+void appendPercentEncoded(const char *text, size_t length, std::string &out);
+
+} // namespace TTS
+
+#endif